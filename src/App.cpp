@@ -6,6 +6,7 @@
 #include "ViKeyManager.h"
 #include "ViMotionAction.h"
 #include "actions.h"
+#include "ExCommands.h"
 
 
 Application *Application::self = 0;
@@ -15,11 +16,14 @@ void setup_vi_keybindings(MainWindow *win, Glib::RefPtr<Gtk::ActionGroup> ui_mgr
 void
 Application::run(int argc, char **argv)
 {
+    if (!Glib::thread_supported())
+        Glib::thread_init();
+
     Gtk::Main kit(argc, argv);
 
     gtksourceview::init();
 
-    m_scm = s7_init();
+    m_scheme = new SchemeWorker();
 
     Glib::RefPtr< gtksourceview::SourceLanguageManager > lm = 
         gtksourceview::SourceLanguageManager::create();
@@ -45,6 +49,16 @@ Application::run(int argc, char **argv)
     setup_vi_keybindings(m_main_window, m_action_group);
 
     Gtk::Main::run(*m_main_window);
+
+    //
+    //  The main window (and its editors) is never destroyed, so a
+    //  normal exit has to remove the swap files and finish writing the
+    //  undo journals here.
+    //
+    m_main_window->get_editor_area()->close_all();
+
+    delete m_scheme;
+    m_scheme = NULL;
 }
 
 Application* Application::get()
@@ -75,9 +89,9 @@ Editor* Application::get_current_editor()
     return ed;
 }
 
-Scheme* Application::get_scheme()
+SchemeWorker* Application::get_scheme()
 {
-    return m_scm;
+    return m_scheme;
 }
 
 void setup_vi_keybindings(MainWindow *win, 
@@ -169,15 +183,84 @@ void setup_vi_keybindings(MainWindow *win,
     ALIAS( last_action, vi_command, ":tabPrev" );
 
     MK_ACTION( "quit", Gtk::Stock::QUIT,
-               vi_command, ":q", 0, sigc::ptr_fun(application_quit) );
+               vi_command, ":q[uit]", 0, sigc::ptr_fun(application_quit) );
+
+    MK_ACTION( "interrupt-scheme", "Interrupts the Scheme evaluation being run",
+               vi_normal, "<C-c>", 0, sigc::ptr_fun(interrupt_scheme) );
 
     MK_ACTION( "open-file", "Opens the given file", 
-               vi_command, ":e", 0, sigc::ptr_fun(open_file) );
+               vi_command, ":e[dit]", 0, sigc::ptr_fun(open_file) );
 
-    ALIAS( last_action, vi_command, ":open" );
+    ALIAS( last_action, vi_command, ":o[pen]" );
 
     MK_ACTION( "close", "Closes the current file", 
-               vi_command, ":close", 0, sigc::ptr_fun(close_current_file) );
+               vi_command, ":clo[se]", 0, sigc::ptr_fun(close_current_file) );
+
+    MK_ACTION( "ex-delete", "Deletes a range of lines",
+               vi_command, ":d[elete]", 0, sigc::ptr_fun(ex_delete) );
+
+    MK_ACTION( "ex-yank", "Yanks a range of lines",
+               vi_command, ":y[ank]", 0, sigc::ptr_fun(ex_yank) );
+
+    MK_ACTION( "ex-copy", "Copies a range of lines below an address",
+               vi_command, ":co[py]", 0, sigc::ptr_fun(ex_copy) );
+
+    ALIAS( last_action, vi_command, ":t" );
+
+    MK_ACTION( "ex-move", "Moves a range of lines below an address",
+               vi_command, ":m[ove]", 0, sigc::ptr_fun(ex_move) );
+
+    MK_ACTION( "ex-join", "Joins a range of lines",
+               vi_command, ":j[oin]", 0, sigc::ptr_fun(ex_join) );
+
+    MK_ACTION( "ex-substitute", "Replaces matches of a pattern in a range of lines",
+               vi_command, ":s[ubstitute]", 0, sigc::ptr_fun(ex_substitute) );
+
+    ALIAS( last_action, vi_command, ":&" );
+
+    MK_ACTION( "ex-global", "Runs a command on lines matching a pattern",
+               vi_command, ":g[lobal]", 0, sigc::bind(sigc::ptr_fun(ex_global), false) );
+
+    MK_ACTION( "ex-vglobal", "Runs a command on lines not matching a pattern",
+               vi_command, ":v[global]", 0, sigc::bind(sigc::ptr_fun(ex_global), true) );
+
+    MK_ACTION( "ex-sort", "Sorts a range of lines",
+               vi_command, ":sor[t]", 0, sigc::ptr_fun(ex_sort) );
+
+    MK_ACTION( "ex-uniq", "Removes repeated lines from a range",
+               vi_command, ":uniq", 0, sigc::ptr_fun(ex_uniq) );
+
+    MK_ACTION( "ex-filter", "Filters lines through, or runs, a shell command",
+               vi_command, ":!", 0, sigc::ptr_fun(ex_bang) );
+
+    MK_ACTION( "ex-read", "Reads a file or the output of a command",
+               vi_command, ":r[ead]", 0, sigc::ptr_fun(ex_read) );
+
+    MK_ACTION( "ex-write", "Saves the file, or writes lines to a command",
+               vi_command, ":w[rite]", 0, sigc::ptr_fun(ex_write) );
+
+    MK_ACTION( "ex-shift-right", "Shifts a range of lines right",
+               vi_command, ":>", 0, sigc::bind(sigc::ptr_fun(ex_shift), Forward) );
+
+    MK_ACTION( "ex-shift-left", "Shifts a range of lines left",
+               vi_command, ":<", 0, sigc::bind(sigc::ptr_fun(ex_shift), Backward) );
+
+    MK_ACTION( "ex-make", "Runs make in the background",
+               vi_command, ":mak[e]", 0, sigc::ptr_fun(ex_make) );
+
+    MK_ACTION( "ex-cnext", "Jumps to the next error from :make",
+               vi_command, ":cn[ext]", 0, sigc::bind(sigc::ptr_fun(ex_cnext), Forward) );
+
+    MK_ACTION( "ex-cprevious", "Jumps to the previous error from :make",
+               vi_command, ":cp[revious]", 0, sigc::bind(sigc::ptr_fun(ex_cnext), Backward) );
+
+    ALIAS( last_action, vi_command, ":cN[ext]" );
+
+    MK_ACTION( "ex-nohlsearch", "Stops highlighting the last search",
+               vi_command, ":noh[lsearch]", 0, sigc::ptr_fun(ex_nohlsearch) );
+
+    MK_ACTION( "ex-perf", "Shows performance counters",
+               vi_command, ":perf", 0, sigc::ptr_fun(ex_perf) );
 
     MK_ACTION( "yank-line", "Yank line", 
                vi_normal, "yy", 0, sigc::bind(sigc::ptr_fun(yank_line), false) );
@@ -348,10 +431,6 @@ void setup_vi_keybindings(MainWindow *win,
     MK_MOTION( "goto-line", "Goes to a line number in the file", 
                vi_normal, "G", 0, sigc::ptr_fun(goto_line));
 
-    MK_MOTION( "goto-buffer-end", "Goes to a the end of the buffer",
-               vi_command, ":$", 0, 
-               sigc::bind(sigc::ptr_fun(goto_specific_line), -1));
-
     MK_MOTION( "goto-buffer-begin", "Goes to a the start of the buffer",
                vi_normal, "gg", 0, 
                sigc::bind(sigc::ptr_fun(goto_specific_line), 1));
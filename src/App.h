@@ -2,9 +2,7 @@
 #define SOURCERER_APP_H
 
 #include "MainWindow.h"
-#include "s7.h"
-
-typedef s7_scheme Scheme;
+#include "SchemeWorker.h"
 
 class Application
 {
@@ -17,7 +15,7 @@ class Application
 
         Editor* get_current_editor();
 
-        Scheme* get_scheme();
+        SchemeWorker* get_scheme();
 
         void quit()
         {
@@ -30,7 +28,7 @@ class Application
         static Application *self;
         MainWindow *m_main_window;
         Glib::RefPtr<Gtk::ActionGroup> m_action_group;
-        s7_scheme *m_scm;
+        SchemeWorker *m_scheme;
 };
 
 #endif
@@ -0,0 +1,222 @@
+#include "AsyncWriter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+AsyncWriter::AsyncWriter() :
+    m_fd(-1),
+    m_thread(NULL),
+    m_quit(false)
+{
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    close();
+}
+
+void AsyncWriter::create( const std::string &path, const std::string &header )
+{
+    std::string data( header );
+    queue( job_create, path, data, 0 );
+}
+
+void AsyncWriter::reopen( const std::string &path, gsize size )
+{
+    std::string none;
+    queue( job_reopen, path, none, size );
+}
+
+void AsyncWriter::append( std::string &data )
+{
+    queue( job_append, "", data, 0 );
+}
+
+void AsyncWriter::replace( std::string &contents )
+{
+    queue( job_replace, "", contents, 0 );
+}
+
+void AsyncWriter::sync()
+{
+    std::string none;
+    queue( job_sync, "", none, 0 );
+}
+
+void AsyncWriter::close()
+{
+    if (!m_thread)
+        return;
+
+    {
+        Glib::Mutex::Lock lock( m_mutex );
+        m_quit = true;
+        m_cond.signal();
+    }
+    m_thread->join();
+    m_thread = NULL;
+    m_quit = false;
+}
+
+void AsyncWriter::remove()
+{
+    std::string none;
+    queue( job_remove, "", none, 0 );
+    close();
+}
+
+//
+// Protected
+//
+void AsyncWriter::queue( JobType type, const std::string &path,
+                         std::string &data, gsize size )
+{
+    Glib::Mutex::Lock lock( m_mutex );
+
+    m_jobs.push_back( Job() );
+    Job &job = m_jobs.back();
+    job.type = type;
+    job.path = path;
+    job.data.swap( data );
+    job.size = size;
+
+    if (!m_thread)
+    {
+        m_thread = Glib::Thread::create(
+                sigc::mem_fun( *this, &AsyncWriter::run ), true );
+    }
+    m_cond.signal();
+}
+
+void AsyncWriter::run()
+{
+    Glib::Mutex::Lock lock( m_mutex );
+    while (true)
+    {
+        while (m_jobs.empty() && !m_quit)
+            m_cond.wait( m_mutex );
+
+        if (m_jobs.empty())
+            break;
+
+        //
+        //  Swap the strings out rather than copying them; a job can
+        //  carry a whole buffer.
+        //
+        Job job;
+        Job &front = m_jobs.front();
+        job.type = front.type;
+        job.path.swap( front.path );
+        job.data.swap( front.data );
+        job.size = front.size;
+        m_jobs.pop_front();
+
+        lock.release();
+        do_job( job );
+        lock.acquire();
+    }
+
+    if (m_fd != -1)
+    {
+        ::close( m_fd );
+        m_fd = -1;
+    }
+}
+
+void AsyncWriter::do_job( Job &job )
+{
+    switch (job.type)
+    {
+        case job_create:
+        {
+            if (m_fd != -1)
+                ::close( m_fd );
+
+            m_path = job.path;
+            std::string dir = Glib::path_get_dirname( m_path );
+            g_mkdir_with_parents( dir.c_str(), 0700 );
+
+            m_fd = g_open( m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+            write_all( job.data );
+            break;
+        }
+
+        case job_reopen:
+            if (m_fd != -1)
+                ::close( m_fd );
+
+            m_path = job.path;
+            m_fd = g_open( m_path.c_str(), O_WRONLY, 0600 );
+            if (m_fd != -1)
+            {
+                ftruncate( m_fd, job.size );
+                lseek( m_fd, 0, SEEK_END );
+            }
+            break;
+
+        case job_append:
+            write_all( job.data );
+            break;
+
+        case job_replace:
+        {
+            if (m_path.empty())
+                break;
+
+            std::string tmp = m_path + ".tmp";
+            int fd = g_open( tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+            if (fd == -1)
+                break;
+
+            std::swap( fd, m_fd );
+            bool ok = write_all( job.data ) && fsync( m_fd ) == 0;
+            std::swap( fd, m_fd );
+
+            if (ok && g_rename( tmp.c_str(), m_path.c_str() ) == 0)
+            {
+                if (m_fd != -1)
+                    ::close( m_fd );
+                m_fd = fd;
+            }
+            else
+            {
+                ::close( fd );
+                g_unlink( tmp.c_str() );
+            }
+            break;
+        }
+
+        case job_sync:
+            if (m_fd != -1)
+                fsync( m_fd );
+            break;
+
+        case job_remove:
+            if (m_fd != -1)
+            {
+                ::close( m_fd );
+                m_fd = -1;
+            }
+            if (!m_path.empty())
+                g_unlink( m_path.c_str() );
+            break;
+    }
+}
+
+bool AsyncWriter::write_all( const std::string &data )
+{
+    const char *p = data.data();
+    gsize left = data.size();
+
+    while (m_fd != -1 && left > 0)
+    {
+        ssize_t n = write( m_fd, p, left );
+        if (n <= 0)
+            return false;
+        p += n;
+        left -= n;
+    }
+    return m_fd != -1;
+}
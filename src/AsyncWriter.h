@@ -0,0 +1,101 @@
+#ifndef SOURCERER_ASYNC_WRITER_H
+#define SOURCERER_ASYNC_WRITER_H
+
+#include <deque>
+#include <string>
+
+#include <gtkmm.h>
+
+/**
+ *  Writes to a file from a background thread. Requests are queued and
+ *  carried out in order, so callers on the main loop never wait for
+ *  the disk. The thread is started by the first request.
+ */
+class AsyncWriter
+{
+    public:
+        AsyncWriter();
+        virtual ~AsyncWriter();
+
+        /**
+         *  Creates (or empties) the file at path and writes header to it.
+         */
+        void create( const std::string &path, const std::string &header );
+
+        /**
+         *  Opens an existing file for appending, after cutting it down
+         *  to size bytes.
+         */
+        void reopen( const std::string &path, gsize size );
+
+        /**
+         *  Appends data to the file. The text is taken from data,
+         *  which is left empty.
+         */
+        void append( std::string &data );
+
+        /**
+         *  Replaces the whole file with contents. The new contents are
+         *  written to a temporary file that is renamed over the old
+         *  one, so a crash leaves either the old file or the new one.
+         *  Later appends go to the new file.
+         *
+         *  The text is taken from contents, which is left empty.
+         */
+        void replace( std::string &contents );
+
+        /**
+         *  Flushes everything written so far to the disk.
+         */
+        void sync();
+
+        /**
+         *  Waits for all queued requests to finish and closes the file.
+         */
+        void close();
+
+        /**
+         *  Like close(), then removes the file.
+         */
+        void remove();
+
+    protected:
+        enum JobType
+        {
+            job_create,
+            job_reopen,
+            job_append,
+            job_replace,
+            job_sync,
+            job_remove
+        };
+
+        struct Job
+        {
+            JobType type;
+            std::string path;
+            std::string data;
+            gsize size;
+        };
+
+        void queue( JobType type, const std::string &path,
+                    std::string &data, gsize size );
+        void run();
+        void do_job( Job &job );
+        bool write_all( const std::string &data );
+
+        int m_fd;                   // only used by the thread
+        std::string m_path;
+
+        Glib::Thread *m_thread;
+        Glib::Mutex m_mutex;
+        Glib::Cond m_cond;
+        std::deque<Job> m_jobs;
+        bool m_quit;
+
+    private:
+        AsyncWriter( const AsyncWriter& );
+        AsyncWriter& operator=( const AsyncWriter& );
+};
+
+#endif
@@ -0,0 +1,404 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "BuildWindow.h"
+#include "utils.h"
+
+BuildWindow::BuildWindow() : Gtk::VBox(),
+    m_pid(0),
+    m_out_fd(-1),
+    m_exited(false),
+    m_status(0),
+    m_n_lines(0),
+    m_current(-1),
+    m_n_errors(0),
+    m_n_warnings(0)
+{
+    m_scrollView.add(m_view);
+    m_scrollView.set_policy(Gtk::POLICY_AUTOMATIC,
+                            Gtk::POLICY_AUTOMATIC);
+    m_buffer = Gtk::TextBuffer::create();
+    m_view.set_buffer( m_buffer );
+    m_view.set_editable( false );
+
+    Pango::FontDescription font("monospace 10");
+    m_view.modify_font( font );
+
+    pack_start(m_scrollView, true, true);
+
+    m_entry_tag = Gtk::TextTag::create( "quickfix-entry" );
+    m_entry_tag->property_weight() = Pango::WEIGHT_BOLD;
+    m_current_tag = Gtk::TextTag::create( "quickfix-current" );
+    m_current_tag->property_paragraph_background() = "#ffff99";
+
+    m_buffer->get_tag_table()->add(m_entry_tag);
+    m_buffer->get_tag_table()->add(m_current_tag);
+
+    m_end = m_buffer->create_mark( m_buffer->end(), false );
+}
+
+BuildWindow::~BuildWindow()
+{
+    stop();
+}
+
+bool BuildWindow::run( const std::string &cmd )
+{
+    stop();
+
+    m_cmd = cmd;
+    m_buffer->set_text( "" );
+    m_partial.clear();
+    m_n_lines = 0;
+    m_dirs.clear();
+    m_dirs.push_back( Glib::get_current_dir() );
+    m_entries.clear();
+    m_current = -1;
+    m_n_errors = 0;
+    m_n_warnings = 0;
+    m_exited = false;
+
+    //
+    //  Errors go to the same pipe as the output, so they are read in
+    //  the order they were written.
+    //
+    std::string sh_cmd = cmd + " 2>&1";
+    gchar *argv[] = { (gchar*)"/bin/sh", (gchar*)"-c", (gchar*)sh_cmd.c_str(), NULL };
+    int in_fd;
+    GError *error = NULL;
+
+    if (!g_spawn_async_with_pipes( NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                                   set_process_group, NULL, &m_pid,
+                                   &in_fd, &m_out_fd, NULL, &error ))
+    {
+        m_pid = 0;
+        get_vi()->show_error( "Couldn't run %s: %s", cmd.c_str(), error->message );
+        g_error_free( error );
+        return false;
+    }
+
+    //
+    //  The build gets no input.
+    //
+    close( in_fd );
+
+    fcntl( m_out_fd, F_SETFL, fcntl( m_out_fd, F_GETFL ) | O_NONBLOCK );
+    m_out_watch = Glib::signal_io().connect(
+                sigc::mem_fun( *this, &BuildWindow::on_output ), m_out_fd,
+                Glib::IO_IN | Glib::IO_ERR | Glib::IO_HUP );
+    g_child_watch_add( m_pid, on_child_exit, this );
+
+    m_buffer->insert( m_buffer->end(), "$ " + cmd + "\n" );
+    m_n_lines++;
+
+    get_vi()->show_message( "Running %s...", cmd.c_str() );
+
+    return true;
+}
+
+const BuildWindow::QuickfixEntry* BuildWindow::step( int count )
+{
+    int n = m_entries.size();
+    if (n == 0)
+        return NULL;
+
+    int next = m_current + count;
+    if (next >= n)
+    {
+        if (m_current == n - 1)
+            return NULL;
+        next = n - 1;
+    }
+    else if (next < 0)
+    {
+        if (m_current <= 0)
+            return NULL;
+        next = 0;
+    }
+
+    Gtk::TextIter start, end;
+    if (m_current >= 0)
+    {
+        start = m_buffer->get_iter_at_line( m_entries[m_current].output_line );
+        end = start;
+        end.forward_line();
+        m_buffer->remove_tag( m_current_tag, start, end );
+    }
+
+    m_current = next;
+
+    start = m_buffer->get_iter_at_line( m_entries[m_current].output_line );
+    end = start;
+    end.forward_line();
+    m_buffer->apply_tag( m_current_tag, start, end );
+    m_view.scroll_to( start, 0.1 );
+
+    return &m_entries[m_current];
+}
+
+//
+// Protected
+//
+bool BuildWindow::on_output( Glib::IOCondition cond )
+{
+    gchar buf[IO_SIZE];
+    gssize n = read( m_out_fd, buf, sizeof(buf) );
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return true;
+
+    if (n <= 0)
+    {
+        close( m_out_fd );
+        m_out_fd = -1;
+        finish();
+        return false;
+    }
+
+    add_output( buf, n );
+    return true;
+}
+
+//
+//  Appends the complete lines read so far to the output and parses
+//  them. The last line is held back until its newline arrives (or the
+//  build ends), so a line is never parsed in pieces and the text
+//  inserted never ends part way through a UTF-8 character.
+//
+void BuildWindow::add_output( const gchar *data, gsize len )
+{
+    m_partial.append( data, len );
+
+    std::string::size_type last_nl = m_partial.rfind( '\n' );
+    if (last_nl == std::string::npos)
+        return;
+
+    gsize complete = last_nl + 1;
+
+    //
+    //  Compilers echo source lines, which needn't be UTF-8.
+    //
+    const gchar *invalid;
+    const gchar *text = m_partial.data();
+    while (!g_utf8_validate( text, complete - (text - m_partial.data()), &invalid ))
+    {
+        m_partial[invalid - m_partial.data()] = '?';
+        text = invalid + 1;
+    }
+
+    Gtk::Adjustment *adj = m_scrollView.get_vadjustment();
+    bool at_bottom = adj->get_value() + adj->get_page_size() >= adj->get_upper() - 1;
+
+    int first_line = m_n_lines;
+    m_buffer->insert( m_buffer->end(), m_partial.data(), m_partial.data() + complete );
+
+    const gchar *p = m_partial.data();
+    const gchar *end = p + complete;
+    while (p < end)
+    {
+        const gchar *nl = (const gchar*)memchr( p, '\n', end - p );
+        parse_line( p, nl - p, m_n_lines++ );
+        p = nl + 1;
+    }
+
+    m_partial.erase( 0, complete );
+
+    //
+    //  Mark the lines that became entries.
+    //
+    for (int i = m_entries.size() - 1; i >= 0 && m_entries[i].output_line >= first_line; --i)
+    {
+        Gtk::TextIter start = m_buffer->get_iter_at_line( m_entries[i].output_line );
+        Gtk::TextIter line_end = start;
+        line_end.forward_to_line_end();
+        m_buffer->apply_tag( m_entry_tag, start, line_end );
+    }
+
+    if (at_bottom)
+        m_view.scroll_to( m_end );
+}
+
+void BuildWindow::parse_line( const gchar *line, gsize len, int output_line )
+{
+    if (parse_directory( line, len ))
+        return;
+
+    //
+    //  The file name runs up to the first ':' followed by a digit; it
+    //  can't have spaces in it, which rules out lines like
+    //  "make: *** [Makefile:12: all] Error 1" and
+    //  "In file included from foo.h:3:".
+    //
+    gsize i = 0;
+    for (; i + 1 < len; ++i)
+    {
+        if (line[i] == ' ' || line[i] == '\t' || line[i] == '[')
+            return;
+        if (i > 0 && line[i] == ':' && g_ascii_isdigit( line[i + 1] ))
+            break;
+    }
+    if (i + 1 >= len)
+        return;
+
+    gsize file_len = i;
+    int lnum = 0;
+    for (i++; i < len && g_ascii_isdigit( line[i] ); ++i)
+        lnum = lnum * 10 + (line[i] - '0');
+    if (i >= len || line[i] != ':' || lnum == 0)
+        return;
+
+    int col = 0;
+    gsize j = i + 1;
+    for (; j < len && g_ascii_isdigit( line[j] ); ++j)
+        col = col * 10 + (line[j] - '0');
+    if (j > i + 1 && j < len && line[j] == ':')
+        i = j;
+    else
+        col = 0;
+
+    for (i++; i < len && line[i] == ' '; ++i)
+        ;
+
+    QuickfixEntry entry;
+    std::string file( line, file_len );
+    if (g_path_is_absolute( file.c_str() ))
+        entry.file = file;
+    else
+        entry.file = Glib::build_filename( m_dirs.back(), file );
+    entry.line = lnum;
+    entry.col = col;
+    entry.message.assign( line + i, len - i );
+    entry.output_line = output_line;
+
+    const std::string &msg = entry.message;
+    if (msg.compare( 0, 5, "error" ) == 0 || msg.compare( 0, 11, "fatal error" ) == 0)
+        entry.type = 'e';
+    else if (msg.compare( 0, 7, "warning" ) == 0)
+        entry.type = 'w';
+    else if (msg.compare( 0, 4, "note" ) == 0)
+        entry.type = 'n';
+    else
+        entry.type = 0;
+
+    if (entry.type == 'e')
+        m_n_errors++;
+    else if (entry.type == 'w')
+        m_n_warnings++;
+
+    m_entries.push_back( entry );
+}
+
+//
+//  Follows make's "Entering directory `dir'" and "Leaving directory"
+//  lines. The quotes are ` and ', or ‘ and ’ in a UTF-8 locale.
+//
+bool BuildWindow::parse_directory( const gchar *line, gsize len )
+{
+    static const char ENTERING[] = "Entering directory ";
+    static const char LEAVING[] = "Leaving directory ";
+
+    if (len < 5 || strncmp( line, "make", 4 ) != 0)
+        return false;
+
+    const gchar *p = g_strstr_len( line, len, ENTERING );
+    if (!p)
+    {
+        if (g_strstr_len( line, len, LEAVING ) && m_dirs.size() > 1)
+        {
+            m_dirs.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    p += sizeof(ENTERING) - 1;
+    const gchar *end = line + len;
+    if (p < end && (*p == '`' || *p == '\''))
+        p++;
+    else if (end - p >= 3 && strncmp( p, "\xe2\x80\x98", 3 ) == 0)
+        p += 3;
+
+    if (end > p && end[-1] == '\'')
+        end--;
+    else if (end - p >= 3 && strncmp( end - 3, "\xe2\x80\x99", 3 ) == 0)
+        end -= 3;
+
+    m_dirs.push_back( std::string( p, end ) );
+    return true;
+}
+
+//
+//  Stops the running build, if there is one. Its exit is left to a
+//  watch that just reaps it.
+//
+void BuildWindow::stop()
+{
+    if (!m_pid)
+        return;
+
+    m_out_watch.disconnect();
+    if (m_out_fd >= 0)
+    {
+        close( m_out_fd );
+        m_out_fd = -1;
+    }
+
+    if (!m_exited)
+    {
+        kill( -m_pid, SIGTERM );
+        g_source_remove_by_user_data( this );
+        g_child_watch_add( m_pid, on_child_exit, NULL );
+    }
+    m_pid = 0;
+}
+
+void BuildWindow::finish()
+{
+    if (!m_exited || m_out_fd >= 0)
+        return;
+
+    if (!m_partial.empty())
+        add_output( "\n", 1 );
+
+    m_pid = 0;
+
+    if (!WIFEXITED( m_status ) || WEXITSTATUS( m_status ) != 0)
+    {
+        get_vi()->show_error( "%s: shell returned %d (%d errors, %d warnings)",
+                              m_cmd.c_str(),
+                              WIFEXITED( m_status ) ? WEXITSTATUS( m_status ) : -1,
+                              m_n_errors, m_n_warnings );
+    }
+    else
+    {
+        get_vi()->show_message( "%s: done (%d errors, %d warnings)",
+                                m_cmd.c_str(), m_n_errors, m_n_warnings );
+    }
+}
+
+void BuildWindow::on_child_exit( GPid pid, gint status, gpointer data )
+{
+    g_spawn_close_pid( pid );
+
+    BuildWindow *self = static_cast<BuildWindow*>( data );
+    if (!self)
+        return;
+
+    self->m_exited = true;
+    self->m_status = status;
+    self->finish();
+}
+
+//
+//  Runs in the child: put the build in its own process group, so
+//  stopping it stops everything it started.
+//
+void BuildWindow::set_process_group( gpointer data )
+{
+    setpgid( 0, 0 );
+}
@@ -0,0 +1,99 @@
+#ifndef SOURCERER_BUILD_WINDOW_H
+#define SOURCERER_BUILD_WINDOW_H
+
+#include <string>
+#include <vector>
+
+#include <gtkmm.h>
+
+/**
+ *  The "Build" page of the bottom info area. Runs :make in the
+ *  background and shows its output as it arrives.
+ *
+ *  The output is read from a non-blocking pipe watched from the main
+ *  loop, so editing carries on while the build runs. Each complete
+ *  line is parsed as it is read; lines in the gcc/clang form
+ *
+ *      file:line:col: message
+ *      file:line: message
+ *
+ *  become entries in the quickfix list, which :cn and :cp step
+ *  through. Relative file names are resolved against the directory
+ *  make said it was in ("Entering directory ...").
+ */
+class BuildWindow : public Gtk::VBox
+{
+    public:
+        struct QuickfixEntry
+        {
+            std::string file;       // absolute
+            int line;
+            int col;                // 0 if there wasn't one
+            char type;              // 'e'rror, 'w'arning, 'n'ote or 0
+            std::string message;
+            int output_line;        // in the build output, from 0
+        };
+
+        /**
+         *  The most bytes read in one go.
+         */
+        static const gsize IO_SIZE = 64 * 1024;
+
+        BuildWindow();
+        virtual ~BuildWindow();
+
+        /**
+         *  Starts cmd with /bin/sh, stopping any build that is still
+         *  running. The output and the quickfix list are cleared.
+         */
+        bool run( const std::string &cmd );
+
+        bool is_running() const { return m_pid != 0; }
+
+        /**
+         *  Moves count entries along the quickfix list (back if count
+         *  is negative) and returns the new current entry, or NULL if
+         *  there are no more entries that way.
+         */
+        const QuickfixEntry* step( int count );
+
+        int get_current() const { return m_current; }
+        int get_entry_count() const { return m_entries.size(); }
+
+    protected:
+        bool on_output( Glib::IOCondition cond );
+
+        void add_output( const gchar *data, gsize len );
+        void parse_line( const gchar *line, gsize len, int output_line );
+        bool parse_directory( const gchar *line, gsize len );
+        void stop();
+        void finish();
+
+        static void on_child_exit( GPid pid, gint status, gpointer data );
+        static void set_process_group( gpointer data );
+
+        Gtk::TextView m_view;
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        Glib::RefPtr<Gtk::TextTag> m_entry_tag;
+        Glib::RefPtr<Gtk::TextTag> m_current_tag;
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_end;      // right gravity
+        Gtk::ScrolledWindow m_scrollView;
+
+        std::string m_cmd;
+        GPid m_pid;
+        int m_out_fd;
+        bool m_exited;
+        gint m_status;
+        sigc::connection m_out_watch;
+
+        std::string m_partial;          // the last, incomplete line
+        int m_n_lines;                  // of output, so far
+        std::vector<std::string> m_dirs;
+
+        std::vector<QuickfixEntry> m_entries;
+        int m_current;
+        int m_n_errors;
+        int m_n_warnings;
+};
+
+#endif
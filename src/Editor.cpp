@@ -29,7 +29,8 @@ Editor::save_as()
     }
 }
 
-SourceEditor::SourceEditor()
+SourceEditor::SourceEditor() :
+    m_highlight(m_sourceView)
 {
     m_scrollView.add(m_sourceView);
     m_scrollView.set_policy(Gtk::POLICY_AUTOMATIC, 
@@ -72,6 +73,9 @@ bool SourceEditor::open(const Glib::ustring &path)
         buffer = gtksourceview::SourceBuffer::create( Gtk::TextTagTable::create() );
     }
 
+    std::string file_path = m_file->get_path();
+    std::string checksum;
+
     if (m_file->query_exists())
     {
         char *contents;
@@ -86,13 +90,79 @@ bool SourceEditor::open(const Glib::ustring &path)
         buffer->set_text(contents);
         set_cursor_at_line( buffer, 1, false );
         buffer->end_not_undoable_action();
+
+        gchar *sum = g_compute_checksum_for_data( G_CHECKSUM_SHA1,
+                                                  (const guchar*)contents,
+                                                  length );
+        checksum = sum;
+        g_free( sum );
+        g_free( contents );
+    }
+    else
+    {
+        gchar *sum = g_compute_checksum_for_string( G_CHECKSUM_SHA1, "", 0 );
+        checksum = sum;
+        g_free( sum );
+    }
+
+    bool recovered = false;
+    if (SwapFile::exists( file_path ))
+    {
+        recovered = recover( file_path, checksum, buffer );
     }
 
     set_buffer( buffer );
 
+    //
+    //  A recovered buffer no longer matches the file, so the saved
+    //  undo history doesn't apply to it.
+    //
+    if (!recovered)
+    {
+        m_journal.open( file_path, checksum );
+        m_undo.set_journal( &m_journal );
+    }
+
+    m_swap.start( file_path, checksum, buffer );
+
     return true;
 }
 
+void SourceEditor::close()
+{
+    m_swap.stop();
+    m_journal.close();
+}
+
+bool SourceEditor::recover( const std::string &path,
+                            const std::string &checksum,
+                            Glib::RefPtr< gtksourceview::SourceBuffer > buffer )
+{
+    Gtk::MessageDialog dialog( "Found a swap file for " + path + 
+                               ".\nThe editor may have crashed with unsaved changes.\n\n"
+                               "Recover the changes?",
+                               false, Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_YES_NO );
+
+    if (dialog.run() != Gtk::RESPONSE_YES)
+    {
+        SwapFile::discard( path );
+        return false;
+    }
+
+    buffer->begin_not_undoable_action();
+    bool ok = m_swap.recover( path, checksum, buffer );
+    set_cursor_at_line( buffer, 1, false );
+    buffer->end_not_undoable_action();
+
+    if (!ok)
+    {
+        g_print("Error: Couldn't recover %s, the swap file doesn't match the file.\n",
+                path.c_str());
+        SwapFile::discard( path );
+    }
+    return ok;
+}
+
 bool SourceEditor::save()
 {
     return false;
@@ -103,6 +173,7 @@ void SourceEditor::set_buffer( Glib::RefPtr< gtksourceview::SourceBuffer > buffe
     m_buffer = buffer;
     m_sourceView.set_source_buffer( buffer );
     m_search.set_buffer( buffer );
+    m_highlight.set_buffer( buffer );
 
     if (buffer->get_language() != NULL)
     {
@@ -110,7 +181,12 @@ void SourceEditor::set_buffer( Glib::RefPtr< gtksourceview::SourceBuffer > buffe
         buffer->set_highlight_matching_brackets(true);
     }
 
-    buffer->set_max_undo_levels(100);
+    //
+    //  Undo is handled by our own history rather than the source
+    //  buffer's, which can only be limited by a level count.
+    //
+    buffer->set_max_undo_levels(0);
+    m_undo.set_buffer( buffer );
 }
 
 bool SourceEditor::search( const Glib::ustring &pattern,
@@ -122,9 +198,28 @@ bool SourceEditor::search( const Glib::ustring &pattern,
     {
         set_cursor( cursor, ext_sel );
         m_sourceView.scroll_to( cursor );
+        m_highlight.count_matches();
         return true;
     }
 
     return false;
 }
 
+bool SourceEditor::undo()
+{
+    if (!m_undo.undo())
+        return false;
+
+    m_sourceView.scroll_to( m_buffer->get_insert() );
+    return true;
+}
+
+bool SourceEditor::redo()
+{
+    if (!m_undo.redo())
+        return false;
+
+    m_sourceView.scroll_to( m_buffer->get_insert() );
+    return true;
+}
+
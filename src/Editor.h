@@ -5,6 +5,9 @@
 #include <gtksourceviewmm/sourceview.h>
 
 #include "Search.h"
+#include "SearchHighlighter.h"
+#include "SwapFile.h"
+#include "UndoHistory.h"
 #include "Vi.h"
 
 class Editor 
@@ -21,6 +24,9 @@ class Editor
                              Direction direction,
                              bool ext_sel = false ) = 0;
 
+        virtual bool undo() = 0;
+        virtual bool redo() = 0;
+
         Glib::RefPtr< Gio::File > get_file() 
         {
             return m_file;
@@ -48,13 +54,40 @@ class SourceEditor : public Editor, public Gtk::VBox
                      Direction direction,
                      bool ext_sel = false );
 
+        bool undo();
+        bool redo();
+
+        /**
+         *  Removes the swap file and waits for the undo journal to be
+         *  written. Done when the application quits, since the editors
+         *  aren't destroyed then.
+         */
+        void close();
+
+        gtksourceview::SourceView& get_view()
+        {
+            return m_sourceView;
+        }
+
     protected:
+        /**
+         *  Asks whether to recover from the swap file left for path,
+         *  and replays it into buffer if so. Returns true if the buffer
+         *  was recovered.
+         */
+        bool recover( const std::string &path,
+                      const std::string &checksum,
+                      Glib::RefPtr< gtksourceview::SourceBuffer > buffer );
 
         gtksourceview::SourceView m_sourceView; 
         Glib::RefPtr< gtksourceview::SourceBuffer > m_buffer;
         Gtk::ScrolledWindow m_scrollView;
 
         SearchSupport m_search;
+        SearchHighlighter m_highlight;
+        UndoJournal m_journal;      // must outlive m_undo
+        UndoHistory m_undo;
+        SwapFile m_swap;
 };
 
 #endif
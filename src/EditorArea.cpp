@@ -19,7 +19,7 @@ void EditorArea::add_editor(SourceEditor *editor)
 }
 
 SourceEditor* 
-EditorArea::get_editor_for_file(Glib::ustring &path)
+EditorArea::get_editor_for_file(const Glib::ustring &path)
 {
     Gtk::Notebook_Helpers::PageList::iterator it;
     for (it = pages().begin(); it != pages().end(); it++)
@@ -29,7 +29,7 @@ EditorArea::get_editor_for_file(Glib::ustring &path)
         SourceEditor *ed = reinterpret_cast<SourceEditor*>(it->get_child());    
         if (ed->get_file()->get_path() == path)
         {
-            return NULL;
+            return ed;
         }
     }
     g_print("Editor not found for file %s\n", path.data());
@@ -41,3 +41,14 @@ void EditorArea::close_editor(SourceEditor *editor)
     remove_page(*editor);
 }
 
+void EditorArea::close_all()
+{
+    Gtk::Notebook_Helpers::PageList::iterator it;
+    for (it = pages().begin(); it != pages().end(); it++)
+    {
+        SourceEditor *ed = dynamic_cast<SourceEditor*>(it->get_child());
+        if (ed)
+            ed->close();
+    }
+}
+
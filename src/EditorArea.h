@@ -12,10 +12,15 @@ class EditorArea : public Gtk::Notebook
         virtual ~EditorArea();
 
         void add_editor(SourceEditor *editor);
-        SourceEditor* get_editor_for_file(Glib::ustring &path);
+        SourceEditor* get_editor_for_file(const Glib::ustring &path);
 
         void close_editor(SourceEditor *editor);
 
+        /**
+         *  Closes the swap files and undo journals of all the editors.
+         */
+        void close_all();
+
     protected:
 
         std::map<Glib::ustring, SourceEditor*> m_editors;
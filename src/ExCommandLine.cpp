@@ -0,0 +1,331 @@
+#include <cstring>
+
+#include "ExCommandLine.h"
+#include "RegexCache.h"
+#include "utils.h"
+
+ExCommandLine::ExCommandLine() :
+    m_pos(0),
+    m_cur_line(1),
+    m_addr_count(0),
+    m_line1(1),
+    m_line2(1),
+    m_bang(false)
+{
+}
+
+bool ExCommandLine::parse( const Glib::ustring &cmd_line,
+                           Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    m_cmd = cmd_line.raw();
+    m_pos = 0;
+    m_buffer = buffer;
+
+    m_cur_line = buffer ? get_cursor_iter( buffer ).get_line() + 1 : 0;
+    m_addr_count = 0;
+    m_line1 = m_line2 = m_cur_line;
+    m_name = "";
+    m_bang = false;
+    m_args = "";
+    m_error = "";
+
+    while (m_pos < m_cmd.size() && (m_cmd[m_pos] == ':' || isblank(m_cmd[m_pos])))
+        m_pos++;
+
+    int last_line = buffer ? get_last_line( buffer ) : 0;
+
+    //
+    //  Range
+    //
+    if (m_pos < m_cmd.size() && m_cmd[m_pos] == '%')
+    {
+        m_pos++;
+        m_line1 = 1;
+        m_line2 = last_line;
+        m_addr_count = 2;
+    }
+    else
+    {
+        bool after_separator = false;
+        while (true)
+        {
+            int line;
+            bool found;
+            if (!parse_address( line, found ))
+                return false;
+
+            skip_blanks();
+            bool at_separator = (m_pos < m_cmd.size() &&
+                                 (m_cmd[m_pos] == ',' || m_cmd[m_pos] == ';'));
+
+            //
+            //  A missing address next to a separator means the cursor line.
+            //
+            if (!found && (after_separator || at_separator))
+            {
+                line = m_cur_line;
+                found = true;
+            }
+
+            if (found)
+            {
+                m_line1 = m_line2;
+                m_line2 = line;
+                m_addr_count++;
+            }
+
+            if (!at_separator)
+                break;
+
+            if (m_cmd[m_pos] == ';')
+                m_cur_line = m_line2;
+            m_pos++;
+            after_separator = true;
+        }
+
+        if (m_addr_count == 1)
+            m_line1 = m_line2;
+        else if (m_addr_count > 2)
+            m_addr_count = 2;
+    }
+
+    if (m_line1 < 0 || m_line2 < 0 || m_line1 > last_line || m_line2 > last_line)
+    {
+        m_error = "E16: Invalid range";
+        return false;
+    }
+
+    if (m_line1 > m_line2)
+        std::swap( m_line1, m_line2 );
+
+    //
+    //  Command name
+    //
+    skip_blanks();
+    gsize start = m_pos;
+    if (m_pos < m_cmd.size())
+    {
+        if (isalpha( m_cmd[m_pos] ))
+        {
+            while (m_pos < m_cmd.size() && isalpha( m_cmd[m_pos] ))
+                m_pos++;
+
+            if (m_pos < m_cmd.size() && m_cmd[m_pos] == '!')
+            {
+                m_name = m_cmd.substr( start, m_pos - start );
+                m_bang = true;
+                m_pos++;
+            }
+        }
+        else
+        {
+            m_pos++;
+        }
+    }
+
+    if (m_name.empty())
+        m_name = m_cmd.substr( start, m_pos - start );
+
+    skip_blanks();
+    m_args = m_cmd.substr( m_pos );
+
+    return true;
+}
+
+//
+// Protected
+//
+bool ExCommandLine::parse_address( int &line, bool &found )
+{
+    found = false;
+    skip_blanks();
+
+    if (m_pos >= m_cmd.size())
+        return true;
+
+    char ch = m_cmd[m_pos];
+
+    if (!m_buffer && strchr( "0123456789.$'/?+-", ch ))
+    {
+        m_error = "E16: Invalid range";
+        return false;
+    }
+
+    if (isdigit( ch ))
+    {
+        line = 0;
+        while (m_pos < m_cmd.size() && isdigit( m_cmd[m_pos] ))
+            line = line * 10 + (m_cmd[m_pos++] - '0');
+        found = true;
+    }
+    else if (ch == '.')
+    {
+        m_pos++;
+        line = m_cur_line;
+        found = true;
+    }
+    else if (ch == '$')
+    {
+        m_pos++;
+        line = get_last_line( m_buffer );
+        found = true;
+    }
+    else if (ch == '\'')
+    {
+        m_pos++;
+        if (m_pos >= m_cmd.size())
+        {
+            m_error = "E20: Mark not set";
+            return false;
+        }
+
+        Glib::ustring name( 1, m_cmd[m_pos++] );
+        Glib::RefPtr<Gtk::TextBuffer::Mark> mark = m_buffer->get_mark( name );
+        if (!mark)
+        {
+            m_error = "E20: Mark not set";
+            return false;
+        }
+
+        line = m_buffer->get_iter_at_mark( mark ).get_line() + 1;
+        found = true;
+    }
+    else if (ch == '/' || ch == '?')
+    {
+        if (!parse_pattern_address( ch, line ))
+            return false;
+        found = true;
+    }
+
+    //
+    //  Offsets
+    //
+    while (m_pos < m_cmd.size() && (m_cmd[m_pos] == '+' || m_cmd[m_pos] == '-'))
+    {
+        int sign = (m_cmd[m_pos++] == '+') ? 1 : -1;
+
+        if (!found)
+        {
+            line = m_cur_line;
+            found = true;
+        }
+
+        int n = 1;
+        if (m_pos < m_cmd.size() && isdigit( m_cmd[m_pos] ))
+        {
+            n = 0;
+            while (m_pos < m_cmd.size() && isdigit( m_cmd[m_pos] ))
+                n = n * 10 + (m_cmd[m_pos++] - '0');
+        }
+        line += sign * n;
+    }
+
+    return true;
+}
+
+bool ExCommandLine::parse_pattern_address( char delim, int &line )
+{
+    //
+    //  Read up to the closing delimiter (which may be left off at the
+    //  end of the line). An escaped delimiter is part of the pattern.
+    //
+    std::string pattern;
+    m_pos++;
+    while (m_pos < m_cmd.size() && m_cmd[m_pos] != delim)
+    {
+        if (m_cmd[m_pos] == '\\' && m_pos + 1 < m_cmd.size() && m_cmd[m_pos + 1] == delim)
+            m_pos++;
+        pattern += m_cmd[m_pos++];
+    }
+    if (m_pos < m_cmd.size())
+        m_pos++;
+
+    if (pattern.empty())
+        pattern = get_vi()->get_last_search().raw();
+    if (pattern.empty())
+    {
+        m_error = "E35: No previous regular expression";
+        return false;
+    }
+
+    GError *error = NULL;
+    GRegex *regex = RegexCache::get()->compile( pattern, G_REGEX_MULTILINE, &error );
+    if (error)
+    {
+        m_error = error->message;
+        g_error_free( error );
+        return false;
+    }
+
+    //
+    //  Search from the line after the cursor line to the end, then wrap
+    //  around (or, backwards, from the line before it to the start).
+    //
+    Gtk::TextIter cur = m_buffer->get_iter_at_line( m_cur_line - 1 );
+    Gtk::TextIter after = cur;
+    after.forward_line();
+
+    Gtk::TextIter first_start, first_end, second_start, second_end;
+    if (delim == '/')
+    {
+        first_start = after;
+        first_end = m_buffer->end();
+        second_start = m_buffer->begin();
+        second_end = after;
+    }
+    else
+    {
+        first_start = m_buffer->begin();
+        first_end = cur;
+        second_start = cur;
+        second_end = m_buffer->end();
+    }
+
+    bool found = false;
+    for (int pass = 0; pass < 2 && !found; ++pass)
+    {
+        Gtk::TextIter start = (pass == 0) ? first_start : second_start;
+        Gtk::TextIter end = (pass == 0) ? first_end : second_end;
+
+        gchar *text = gtk_text_buffer_get_text( m_buffer->gobj(), start.gobj(),
+                                                end.gobj(), TRUE );
+
+        GMatchInfo *match_info;
+        g_regex_match( regex, text, (GRegexMatchFlags)0, &match_info );
+
+        gint match_start = -1, match_end;
+        while (g_match_info_matches( match_info ))
+        {
+            g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+            if (delim == '/')
+                break;
+            g_match_info_next( match_info, NULL );
+        }
+
+        if (match_start != -1)
+        {
+            Gtk::TextIter iter = start;
+            iter.forward_chars( g_utf8_pointer_to_offset( text, text + match_start ) );
+            line = iter.get_line() + 1;
+            found = true;
+        }
+
+        g_match_info_free( match_info );
+        g_free( text );
+    }
+
+    g_regex_unref( regex );
+
+    if (!found)
+    {
+        m_error = "E486: Pattern not found: " + pattern;
+        return false;
+    }
+    return true;
+}
+
+void ExCommandLine::skip_blanks()
+{
+    while (m_pos < m_cmd.size() && isblank( m_cmd[m_pos] ))
+        m_pos++;
+}
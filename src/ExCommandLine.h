@@ -0,0 +1,75 @@
+#ifndef SOURCERER_EX_COMMAND_LINE_H
+#define SOURCERER_EX_COMMAND_LINE_H
+
+#include <string>
+
+#include <gtkmm.h>
+
+/**
+ *  A parsed ex command line:
+ *
+ *      [range] name[!] [args]
+ *
+ *  The range is made of up to two addresses separated by ',' or ';'
+ *  (';' moves to the first address before the second is read), or '%'
+ *  for the whole buffer. An address is one of:
+ *
+ *      N         line N
+ *      .         the cursor line
+ *      $         the last line
+ *      'x        the line of mark x
+ *      /pat/     the next line matching pat (?pat? searches backwards)
+ *
+ *  followed by any number of +N / -N offsets. An offset on its own is
+ *  relative to the cursor line.
+ *
+ *  Lines are numbered from 1. Without a range, both lines are the
+ *  cursor line.
+ */
+class ExCommandLine
+{
+    public:
+        ExCommandLine();
+
+        /**
+         *  Parses cmd_line, resolving addresses against buffer. Returns
+         *  false, and sets the error message, if it is malformed. The
+         *  buffer may be empty (NULL) if the command line has no range.
+         */
+        bool parse( const Glib::ustring &cmd_line,
+                    Glib::RefPtr<Gtk::TextBuffer> buffer );
+
+        /**
+         *  Number of addresses given (0, 1 or 2).
+         */
+        int get_addr_count() const { return m_addr_count; }
+
+        int get_line1() const { return m_line1; }
+        int get_line2() const { return m_line2; }
+
+        const Glib::ustring& get_name() const { return m_name; }
+        bool get_bang() const { return m_bang; }
+        const Glib::ustring& get_args() const { return m_args; }
+
+        const Glib::ustring& get_error() const { return m_error; }
+
+    protected:
+        bool parse_address( int &line, bool &found );
+        bool parse_pattern_address( char delim, int &line );
+        void skip_blanks();
+
+        std::string m_cmd;
+        gsize m_pos;
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        int m_cur_line;
+
+        int m_addr_count;
+        int m_line1;
+        int m_line2;
+        Glib::ustring m_name;
+        bool m_bang;
+        Glib::ustring m_args;
+        Glib::ustring m_error;
+};
+
+#endif
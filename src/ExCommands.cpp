@@ -0,0 +1,1150 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <gtkmm.h>
+#include <gtksourceviewmm/sourceview.h>
+
+#include "App.h"
+#include "actions.h"
+#include "ExCommandLine.h"
+#include "Editor.h"
+#include "ExCommands.h"
+#include "FilterJob.h"
+#include "GlobalCommand.h"
+#include "LineSorter.h"
+#include "RegexCache.h"
+#include "SearchHighlighter.h"
+#include "utils.h"
+
+//
+//  Gets the focused buffer and the range for the command being run.
+//  Without a range, both lines are the cursor line. Line 0 is moved up
+//  to 1 unless the command takes it to mean "before the first line"
+//  (allow_zero), as :read does.
+//
+static Glib::RefPtr<Gtk::TextBuffer> get_buffer_and_range( int &first, int &last,
+                                                           bool allow_zero = false )
+{
+    Gtk::Widget *w = get_focused_widget();
+    if (!is_text_widget(w))
+    {
+        return Glib::RefPtr<Gtk::TextBuffer>();
+    }
+
+    Gtk::TextView *view = static_cast<Gtk::TextView*>(w);
+    Glib::RefPtr<Gtk::TextBuffer> buffer = view->get_buffer();
+
+    if (get_vi()->get_cmd_range( first, last ) == 0)
+    {
+        first = last = get_cursor_iter( buffer ).get_line() + 1;
+    }
+
+    int lowest = allow_zero ? 0 : 1;
+    if (first < lowest)
+        first = lowest;
+    if (last < first)
+        last = first;
+
+    return buffer;
+}
+
+//
+//  Reads an optional register name and an optional count:  [x] [count]
+//  A count replaces the range with count lines from its last line.
+//
+static void parse_register_and_count( char &reg, int &first, int &last,
+                                      Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    std::string args = get_vi()->get_cmd_params().raw();
+    gsize i = 0;
+
+    reg = get_vi()->get_current_register();
+
+    while (i < args.size() && isblank( args[i] ))
+        i++;
+    if (i < args.size() && !isdigit( args[i] ))
+        reg = args[i++];
+
+    while (i < args.size() && isblank( args[i] ))
+        i++;
+    if (i < args.size() && isdigit( args[i] ))
+    {
+        int count = atoi( args.c_str() + i );
+        if (count > 0)
+        {
+            first = last;
+            last = std::min( first + count - 1, get_last_line( buffer ) );
+        }
+    }
+}
+
+//
+//  Gets iterators for the start of line first and the start of the
+//  line after last.
+//
+static void get_line_bounds( Glib::RefPtr<Gtk::TextBuffer> buffer,
+                             int first, int last,
+                             Gtk::TextIter &start, Gtk::TextIter &end )
+{
+    start = buffer->get_iter_at_line( first - 1 );
+    end = buffer->get_iter_at_line( last - 1 );
+    end.forward_line();
+}
+
+//
+//  Gets the text of lines first to last, always ending with a newline.
+//  The text is g_malloc'd, to be handed to a register without a copy.
+//
+static gchar* get_lines( Glib::RefPtr<Gtk::TextBuffer> buffer,
+                         int first, int last, gsize &len )
+{
+    Gtk::TextIter start, end;
+    get_line_bounds( buffer, first, last, start, end );
+
+    gchar *text = gtk_text_buffer_get_text( buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+    len = strlen( text );
+    if (len == 0 || text[len - 1] != '\n')
+    {
+        text = (gchar*)g_realloc( text, len + 2 );
+        text[len++] = '\n';
+        text[len] = '\0';
+    }
+    return text;
+}
+
+//
+//  Deletes lines first to last. When the last line of the buffer has
+//  no newline, the newline before the range goes instead.
+//
+static void delete_lines( Glib::RefPtr<Gtk::TextBuffer> buffer, int first, int last )
+{
+    Gtk::TextIter start, end;
+    get_line_bounds( buffer, first, last, start, end );
+
+    if (end.is_end() && !end.starts_line() && !start.is_start())
+        start.backward_char();
+
+    buffer->erase( start, end );
+}
+
+//
+//  Inserts text (whole lines, ending with a newline) below line
+//  after_line, or above the first line if after_line is 0.
+//
+static void insert_lines( Glib::RefPtr<Gtk::TextBuffer> buffer, int after_line,
+                          const gchar *text, gsize len )
+{
+    Gtk::TextIter iter;
+    if (after_line == 0)
+    {
+        iter = buffer->begin();
+    }
+    else
+    {
+        iter = buffer->get_iter_at_line( after_line - 1 );
+        iter.forward_line();
+    }
+
+    if (iter.is_end() && !iter.starts_line())
+    {
+        //
+        //  The last line has no newline: add one and leave off the
+        //  text's own.
+        //
+        iter = buffer->insert( iter, "\n" );
+        len--;
+    }
+
+    buffer->insert( iter, text, text + len );
+}
+
+//
+//  Parses the destination address of :copy and :move.
+//
+static bool get_destination( Glib::RefPtr<Gtk::TextBuffer> buffer, int &dest )
+{
+    ExCommandLine addr;
+    if (!addr.parse( get_vi()->get_cmd_params(), buffer ))
+    {
+        get_vi()->show_error( "%s", addr.get_error().c_str() );
+        return false;
+    }
+
+    if (addr.get_addr_count() == 0 || !addr.get_name().empty())
+    {
+        get_vi()->show_error( "E14: Invalid address" );
+        return false;
+    }
+
+    dest = addr.get_line2();
+    return true;
+}
+
+static void yank_or_delete( bool del )
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer)
+        return;
+
+    char reg;
+    parse_register_and_count( reg, first, last, buffer );
+
+    gsize len;
+    gchar *text = get_lines( buffer, first, last, len );
+    get_vi()->set_register( reg, ViTextChunk::create( text, len ), vi_linewise );
+
+    if (del)
+    {
+        buffer->begin_user_action();
+        delete_lines( buffer, first, last );
+        buffer->end_user_action();
+
+        set_cursor_at_line( buffer, std::min( first, get_last_line( buffer ) ), false );
+    }
+
+    int n = last - first + 1;
+    if (n > 2)
+        get_vi()->show_message( "%d lines %s", n, del ? "deleted" : "yanked" );
+}
+
+void ex_delete()
+{
+    yank_or_delete( true );
+}
+
+void ex_yank()
+{
+    yank_or_delete( false );
+}
+
+void ex_copy()
+{
+    int first, last, dest;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer || !get_destination( buffer, dest ))
+        return;
+
+    gsize len;
+    gchar *text = get_lines( buffer, first, last, len );
+
+    buffer->begin_user_action();
+    insert_lines( buffer, dest, text, len );
+    buffer->end_user_action();
+
+    g_free( text );
+
+    set_cursor_at_line( buffer, dest + last - first + 1, false );
+}
+
+void ex_move()
+{
+    int first, last, dest;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer || !get_destination( buffer, dest ))
+        return;
+
+    if (dest >= first && dest < last)
+    {
+        get_vi()->show_error( "E134: Cannot move a range of lines into itself" );
+        return;
+    }
+
+    int n = last - first + 1;
+    if (dest == last || dest == first - 1)
+    {
+        set_cursor_at_line( buffer, last, false );
+        return;
+    }
+
+    gsize len;
+    gchar *text = get_lines( buffer, first, last, len );
+
+    //
+    //  Insert the copy first; if it goes above the range, the range
+    //  moves down by n lines.
+    //
+    buffer->begin_user_action();
+    insert_lines( buffer, dest, text, len );
+    if (dest < first)
+        delete_lines( buffer, first + n, last + n );
+    else
+        delete_lines( buffer, first, last );
+    buffer->end_user_action();
+
+    g_free( text );
+
+    set_cursor_at_line( buffer, (dest < first) ? dest + n : dest, false );
+}
+
+void ex_join()
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer)
+        return;
+
+    int count = atoi( get_vi()->get_cmd_params().c_str() );
+    if (count > 0)
+    {
+        first = last;
+        last = first + count - 1;
+    }
+    else if (first == last)
+    {
+        last = first + 1;
+    }
+
+    last = std::min( last, get_last_line( buffer ) );
+    if (first >= last)
+        return;
+
+    bool bang = get_vi()->get_cmd_bang();
+
+    Gtk::TextIter start = buffer->get_iter_at_line( first - 1 );
+    Gtk::TextIter end = buffer->get_iter_at_line( last - 1 );
+    if (!end.ends_line())
+        end.forward_to_line_end();
+
+    gchar *text = gtk_text_buffer_get_text( buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+
+    std::string joined;
+    joined.reserve( strlen( text ) );
+
+    const gchar *line = text;
+    for (bool first_line = true; line; first_line = false)
+    {
+        const gchar *nl = strchr( line, '\n' );
+        const gchar *line_end = nl ? nl : line + strlen( line );
+
+        if (!first_line && !bang)
+        {
+            while (line < line_end && isblank( *line ))
+                line++;
+
+            if (line < line_end && *line != ')' &&
+                !joined.empty() && !isblank( joined[joined.size() - 1] ))
+            {
+                joined += ' ';
+            }
+        }
+
+        joined.append( line, line_end - line );
+        line = nl ? nl + 1 : NULL;
+    }
+
+    g_free( text );
+
+    buffer->begin_user_action();
+    start = buffer->erase( start, end );
+    buffer->insert( start, joined.data(), joined.data() + joined.size() );
+    buffer->end_user_action();
+
+    set_cursor_at_line( buffer, first, false );
+}
+
+//
+//  The last substitution, repeated by ":s" without a pattern and ":&".
+//
+static std::string s_last_pattern;
+static std::string s_last_replacement;
+static bool s_last_global = false;
+static bool s_last_confirm = false;
+static bool s_last_caseless = false;
+
+enum ConfirmResponse
+{
+    confirm_yes = 1,
+    confirm_no,
+    confirm_all,
+    confirm_quit
+};
+
+//
+//  Reads up to an unescaped delim, leaving pos after it. An escaped
+//  delim is taken literally; other escapes are kept as they are.
+//
+static std::string read_delimited( const std::string &str, gsize &pos, char delim )
+{
+    std::string out;
+    while (pos < str.size() && str[pos] != delim)
+    {
+        if (str[pos] == '\\' && pos + 1 < str.size())
+        {
+            if (str[pos + 1] == delim)
+            {
+                out += delim;
+                pos += 2;
+                continue;
+            }
+            out += str[pos++];
+        }
+        out += str[pos++];
+    }
+    if (pos < str.size())
+        pos++;
+    return out;
+}
+
+//
+//  Converts a Vim replacement string to GRegex syntax: & is the whole
+//  match and \r a line break. \1 - \9, \n, \t and \\ are the same.
+//
+static std::string convert_replacement( const std::string &repl )
+{
+    std::string out;
+    for (gsize i = 0; i < repl.size(); ++i)
+    {
+        if (repl[i] == '&')
+        {
+            out += "\\0";
+        }
+        else if (repl[i] == '\\' && i + 1 < repl.size())
+        {
+            char next = repl[++i];
+            if (next == '&')
+                out += '&';
+            else if (next == 'r')
+                out += "\\n";
+            else
+            {
+                out += '\\';
+                out += next;
+            }
+        }
+        else
+        {
+            out += repl[i];
+        }
+    }
+    return out;
+}
+
+static int count_newlines( const gchar *start, const gchar *end )
+{
+    int n = 0;
+    while (start < end &&
+           (start = (const gchar*)memchr( start, '\n', end - start )) != NULL)
+    {
+        n++;
+        start++;
+    }
+    return n;
+}
+
+//
+//  Selects the match and asks whether to replace it.
+//
+static int confirm_replacement( Gtk::TextView *view, Glib::RefPtr<Gtk::TextBuffer> buffer,
+                                int offset, int n_chars )
+{
+    Gtk::TextIter start = buffer->get_iter_at_offset( offset );
+    Gtk::TextIter end = buffer->get_iter_at_offset( offset + n_chars );
+    buffer->select_range( start, end );
+    view->scroll_to( start, 0.1 );
+
+    Gtk::MessageDialog dialog( *Application::get()->get_main_window(),
+                               "Replace this match?",
+                               false, Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_NONE );
+    dialog.add_button( "_Yes", confirm_yes );
+    dialog.add_button( "_No", confirm_no );
+    dialog.add_button( "_All", confirm_all );
+    dialog.add_button( "_Quit", confirm_quit );
+    dialog.set_default_response( confirm_yes );
+
+    return dialog.run();
+}
+
+void ex_substitute()
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer)
+        return;
+
+    Gtk::TextView *view = static_cast<Gtk::TextView*>( get_focused_widget() );
+
+    //
+    //  /{pattern}/{string}/ -- any punctuation can be the delimiter.
+    //
+    std::string args = get_vi()->get_cmd_params().raw();
+    gsize pos = 0;
+
+    bool global = false;
+    bool confirm = false;
+    bool caseless = false;
+
+    if (!args.empty() && ispunct( args[0] ) && !strchr( "\\\"|&", args[0] ))
+    {
+        char delim = args[pos++];
+        std::string pattern = read_delimited( args, pos, delim );
+        s_last_replacement = read_delimited( args, pos, delim );
+        if (pattern.empty())
+            pattern = get_vi()->get_last_search().raw();
+        if (!pattern.empty())
+            s_last_pattern = pattern;
+    }
+
+    for (; pos < args.size() && strchr( "&gciI", args[pos] ); ++pos)
+    {
+        switch (args[pos])
+        {
+            case '&':
+                global = s_last_global;
+                confirm = s_last_confirm;
+                caseless = s_last_caseless;
+                break;
+            case 'g': global = !global; break;
+            case 'c': confirm = true; break;
+            case 'i': caseless = true; break;
+            case 'I': caseless = false; break;
+        }
+    }
+
+    int count = atoi( args.c_str() + pos );
+    if (count > 0)
+    {
+        first = last;
+        last = std::min( first + count - 1, get_last_line( buffer ) );
+    }
+
+    if (s_last_pattern.empty())
+    {
+        get_vi()->show_error( "E35: No previous regular expression" );
+        return;
+    }
+
+    s_last_global = global;
+    s_last_confirm = confirm;
+    s_last_caseless = caseless;
+
+    GError *error = NULL;
+    int compile_flags = G_REGEX_MULTILINE;
+    if (caseless)
+        compile_flags |= G_REGEX_CASELESS;
+
+    GRegex *regex = RegexCache::get()->compile( s_last_pattern, compile_flags, &error );
+    if (error)
+    {
+        get_vi()->show_error( "%s", error->message );
+        g_error_free( error );
+        return;
+    }
+
+    std::string replacement = convert_replacement( s_last_replacement );
+    if (!g_regex_check_replacement( replacement.c_str(), NULL, &error ))
+    {
+        get_vi()->show_error( "%s", error->message );
+        g_error_free( error );
+        g_regex_unref( regex );
+        return;
+    }
+
+    get_vi()->set_last_search( s_last_pattern, Forward );
+
+    Gtk::TextIter start = buffer->get_iter_at_line( first - 1 );
+    Gtk::TextIter end = buffer->get_iter_at_line( last - 1 );
+    if (!end.ends_line())
+        end.forward_to_line_end();
+
+    gchar *text = gtk_text_buffer_get_text( buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+    gsize len = strlen( text );
+    int start_offset = start.get_offset();
+
+    //
+    //  Build the replacement for the span from the first to the last
+    //  replaced match in one pass. Nothing in the buffer changes until
+    //  the whole span is swapped in at the end, so offsets stay valid
+    //  while confirming.
+    //
+    std::string out;
+    gssize span_start = -1;
+    gsize copied = 0;
+
+    int n_matches = 0;
+    int n_subs = 0;
+    int n_lines = 0;
+    int line = first;
+    int last_sub_line = 0;
+    gsize counted = 0;
+
+    bool all = !confirm;
+    glong chars = 0;
+    gsize chars_pos = 0;
+
+    GMatchInfo *match_info;
+    g_regex_match_full( regex, text, len, 0, (GRegexMatchFlags)0, &match_info, NULL );
+
+    while (g_match_info_matches( match_info ))
+    {
+        gint match_start, match_end;
+        g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+        n_matches++;
+
+        line += count_newlines( text + counted, text + match_start );
+        counted = match_start;
+
+        bool replace = true;
+        if (!all)
+        {
+            chars += g_utf8_pointer_to_offset( text + chars_pos, text + match_start );
+            chars_pos = match_start;
+
+            int response = confirm_replacement(
+                        view, buffer, start_offset + chars,
+                        g_utf8_pointer_to_offset( text + match_start, text + match_end ) );
+
+            if (response == confirm_all)
+                all = true;
+            else if (response == confirm_no)
+                replace = false;
+            else if (response != confirm_yes)
+                break;
+        }
+
+        if (replace)
+        {
+            if (span_start < 0)
+                span_start = copied = match_start;
+
+            out.append( text + copied, match_start - copied );
+
+            gchar *expanded = g_match_info_expand_references( match_info,
+                                                              replacement.c_str(),
+                                                              NULL );
+            out += expanded;
+            g_free( expanded );
+
+            copied = match_end;
+            n_subs++;
+            if (line != last_sub_line)
+            {
+                n_lines++;
+                last_sub_line = line;
+            }
+        }
+
+        if (global)
+        {
+            g_match_info_next( match_info, NULL );
+        }
+        else
+        {
+            //
+            //  Only the first match on a line: carry on from the next line.
+            //
+            const gchar *nl = (const gchar*)memchr( text + match_start, '\n',
+                                                    len - match_start );
+            if (!nl)
+                break;
+
+            gint next = std::max<gint>( nl + 1 - text, match_end );
+            g_match_info_free( match_info );
+            g_regex_match_full( regex, text, len, next, (GRegexMatchFlags)0,
+                                &match_info, NULL );
+        }
+    }
+
+    g_match_info_free( match_info );
+    g_regex_unref( regex );
+
+    if (n_subs == 0)
+    {
+        g_free( text );
+        if (n_matches == 0)
+            get_vi()->show_error( "E486: Pattern not found: %s", s_last_pattern.c_str() );
+        set_cursor( get_cursor_iter( buffer ), false );
+        return;
+    }
+
+    glong span_offset = start_offset + g_utf8_pointer_to_offset( text, text + span_start );
+    glong span_chars = g_utf8_pointer_to_offset( text + span_start, text + copied );
+    g_free( text );
+
+    buffer->begin_user_action();
+    Gtk::TextIter span_begin = buffer->get_iter_at_offset( span_offset );
+    Gtk::TextIter span_end = buffer->get_iter_at_offset( span_offset + span_chars );
+    span_begin = buffer->erase( span_begin, span_end );
+    span_begin = buffer->insert( span_begin, out.data(), out.data() + out.size() );
+    buffer->end_user_action();
+
+    set_cursor_at_line( buffer, span_begin.get_line() + 1, false );
+
+    if (n_subs > 2)
+        get_vi()->show_message( "%d substitution%s on %d line%s",
+                                n_subs, n_subs == 1 ? "" : "s",
+                                n_lines, n_lines == 1 ? "" : "s" );
+}
+
+void ex_global( bool invert )
+{
+    if (GlobalCommand::is_running())
+    {
+        get_vi()->show_error( "E147: Cannot do :global recursive" );
+        return;
+    }
+
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer)
+        return;
+
+    if (get_vi()->get_cmd_range( first, last ) == 0)
+    {
+        first = 1;
+        last = get_last_line( buffer );
+    }
+
+    if (get_vi()->get_cmd_bang())
+        invert = !invert;
+
+    std::string args = get_vi()->get_cmd_params().raw();
+    if (args.empty() || !ispunct( args[0] ) || strchr( "\\\"|", args[0] ))
+    {
+        get_vi()->show_error( "E146: Regular expressions can't be delimited by letters" );
+        return;
+    }
+
+    gsize pos = 1;
+    std::string pattern = read_delimited( args, pos, args[0] );
+    if (pattern.empty())
+        pattern = get_vi()->get_last_search().raw();
+    if (pattern.empty())
+    {
+        get_vi()->show_error( "E35: No previous regular expression" );
+        return;
+    }
+
+    while (pos < args.size() && isblank( args[pos] ))
+        pos++;
+    Glib::ustring cmd = args.substr( pos );
+
+    get_vi()->set_last_search( pattern, Forward );
+
+    GlobalCommand global( buffer );
+    if (!global.mark_lines( pattern, first, last, invert ))
+    {
+        get_vi()->show_error( "%s", global.get_error().c_str() );
+        return;
+    }
+
+    if (global.get_n_marked() == 0)
+    {
+        if (invert)
+            get_vi()->show_message( "Pattern found in every line: %s", pattern.c_str() );
+        else
+            get_vi()->show_error( "E486: Pattern not found: %s", pattern.c_str() );
+        return;
+    }
+
+    if (cmd.empty())
+    {
+        get_vi()->show_message( "%d matching lines", (int)global.get_n_marked() );
+        return;
+    }
+
+    global.run( cmd );
+}
+
+//
+//  Gets the range for :sort and :uniq, which is the whole buffer by
+//  default.
+//
+static Glib::RefPtr<Gtk::TextBuffer> get_buffer_and_block( int &first, int &last )
+{
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (buffer && get_vi()->get_cmd_range( first, last ) == 0)
+    {
+        first = 1;
+        last = get_last_line( buffer );
+    }
+    return buffer;
+}
+
+//
+//  Sorts lines first to last (or removes repeated lines, if uniq is
+//  true) and swaps the result in with a single edit.
+//
+static void sort_lines( Glib::RefPtr<Gtk::TextBuffer> buffer, int first, int last,
+                          LineSorter &sorter, bool uniq )
+{
+    Gtk::TextIter start = buffer->get_iter_at_line( first - 1 );
+    Gtk::TextIter end = buffer->get_iter_at_line( last - 1 );
+    if (!end.ends_line())
+        end.forward_to_line_end();
+
+    gchar *text = gtk_text_buffer_get_text( buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+    gsize len = strlen( text );
+
+    std::string out;
+    if (uniq)
+        LineSorter::uniq( text, len, out );
+    else
+        sorter.sort( text, len, out );
+
+    bool changed = (out.size() != len || memcmp( out.data(), text, len ) != 0);
+    g_free( text );
+
+    if (changed)
+    {
+        buffer->begin_user_action();
+        start = buffer->erase( start, end );
+        buffer->insert( start, out.data(), out.data() + out.size() );
+        buffer->end_user_action();
+    }
+
+    set_cursor_at_line( buffer, first, false );
+
+    int n_removed = (last - first + 1) - (count_newlines( out.data(), out.data() + out.size() ) + 1);
+    if (n_removed > 2)
+        get_vi()->show_message( "%d fewer lines", n_removed );
+}
+
+void ex_sort()
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_block( first, last );
+    if (!buffer)
+        return;
+
+    std::string args = get_vi()->get_cmd_params().raw();
+    std::string pattern;
+    int flags = 0;
+
+    if (get_vi()->get_cmd_bang())
+        flags |= LineSorter::sort_reverse;
+
+    for (gsize pos = 0; pos < args.size(); )
+    {
+        char ch = args[pos];
+        if (isblank( ch ))
+        {
+            pos++;
+            continue;
+        }
+
+        switch (ch)
+        {
+            case 'n': flags |= LineSorter::sort_numeric; break;
+            case 'u': flags |= LineSorter::sort_unique; break;
+            case 'r': flags |= LineSorter::sort_on_match; break;
+            case 'i': flags |= LineSorter::sort_ignore_case; break;
+            default:
+                if (!ispunct( ch ) || strchr( "\\\"|", ch ))
+                {
+                    get_vi()->show_error( "E474: Invalid argument" );
+                    return;
+                }
+
+                pos++;
+                pattern = read_delimited( args, pos, ch );
+                if (pattern.empty())
+                    pattern = get_vi()->get_last_search().raw();
+                continue;
+        }
+        pos++;
+    }
+
+    LineSorter sorter( flags );
+    if (!pattern.empty() && !sorter.set_pattern( pattern ))
+    {
+        get_vi()->show_error( "%s", sorter.get_error().c_str() );
+        return;
+    }
+
+    sort_lines( buffer, first, last, sorter, false );
+}
+
+void ex_uniq()
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_block( first, last );
+    if (!buffer)
+        return;
+
+    LineSorter sorter( 0 );
+    sort_lines( buffer, first, last, sorter, true );
+}
+
+void ex_bang()
+{
+    std::string cmd = get_vi()->get_cmd_params().raw();
+    if (cmd.empty())
+    {
+        get_vi()->show_error( "E471: Argument required" );
+        return;
+    }
+
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+
+    if (buffer && get_vi()->get_cmd_range( first, last ) > 0)
+        FilterJob::start( FilterJob::filter_lines, cmd, buffer, first, last );
+    else
+        FilterJob::start( FilterJob::run_command, cmd, buffer, 0, 0 );
+}
+
+void ex_read()
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last, true );
+    if (!buffer)
+        return;
+
+    std::string args = get_vi()->get_cmd_params().raw();
+    if (get_vi()->get_cmd_bang())
+        args.insert( 0, "!" );
+
+    if (!args.empty() && args[0] == '!')
+    {
+        FilterJob::start( FilterJob::read_output, args.substr( 1 ), buffer, first, last );
+        return;
+    }
+
+    if (args.empty())
+    {
+        get_vi()->show_error( "E32: No file name" );
+        return;
+    }
+
+    gchar *contents;
+    gsize len;
+    GError *error = NULL;
+    if (!g_file_get_contents( args.c_str(), &contents, &len, &error ))
+    {
+        get_vi()->show_error( "E484: Can't open file %s", args.c_str() );
+        g_error_free( error );
+        return;
+    }
+
+    if (!g_utf8_validate( contents, len, NULL ))
+    {
+        get_vi()->show_error( "%s isn't valid UTF-8", args.c_str() );
+        g_free( contents );
+        return;
+    }
+
+    if (len > 0 && contents[len - 1] != '\n')
+    {
+        contents = (gchar*)g_realloc( contents, len + 2 );
+        contents[len++] = '\n';
+        contents[len] = '\0';
+    }
+
+    if (len > 0)
+    {
+        buffer->begin_user_action();
+        insert_lines( buffer, last, contents, len );
+        buffer->end_user_action();
+        set_cursor_at_line( buffer, last + 1, false );
+    }
+
+    g_free( contents );
+}
+
+void ex_write()
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_block( first, last );
+
+    std::string args = get_vi()->get_cmd_params().raw();
+    if (!args.empty() && args[0] == '!')
+    {
+        if (buffer)
+            FilterJob::start( FilterJob::write_lines, args.substr( 1 ), buffer, first, last );
+        return;
+    }
+
+    Editor *ed = Application::get()->get_current_editor();
+    if (!ed || !ed->save())
+        get_vi()->show_error( "E212: Can't open file for writing" );
+}
+
+void ex_shift( Direction dir )
+{
+    int first, last;
+    Glib::RefPtr<Gtk::TextBuffer> buffer = get_buffer_and_range( first, last );
+    if (!buffer)
+        return;
+
+    //
+    //  Extra > or < characters shift by more indents.
+    //
+    std::string args = get_vi()->get_cmd_params().raw();
+    char shift_char = (dir == Forward) ? '>' : '<';
+    int levels = 1;
+    gsize i = 0;
+    while (i < args.size() && (args[i] == shift_char || isblank( args[i] )))
+    {
+        if (args[i++] == shift_char)
+            levels++;
+    }
+
+    int count = atoi( args.c_str() + i );
+    if (count > 0)
+    {
+        first = last;
+        last = std::min( first + count - 1, get_last_line( buffer ) );
+    }
+
+    int tab_width = 8;
+    bool use_spaces = false;
+    Gtk::Widget *w = get_focused_widget();
+    if (is_source_view(w))
+    {
+        gtksourceview::SourceView *view = static_cast<gtksourceview::SourceView*>(w);
+        tab_width = view->get_tab_width();
+        use_spaces = view->get_insert_spaces_instead_of_tabs();
+    }
+
+    int shift = levels * tab_width;
+    if (dir == Backward)
+        shift = -shift;
+
+    Gtk::TextIter start = buffer->get_iter_at_line( first - 1 );
+    Gtk::TextIter end = buffer->get_iter_at_line( last - 1 );
+    if (!end.ends_line())
+        end.forward_to_line_end();
+
+    gchar *text = gtk_text_buffer_get_text( buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+
+    std::string shifted;
+    shifted.reserve( strlen( text ) + (last - first + 1) * std::max( shift, 0 ) );
+
+    const gchar *line = text;
+    while (line)
+    {
+        const gchar *nl = strchr( line, '\n' );
+        const gchar *line_end = nl ? nl : line + strlen( line );
+
+        //
+        //  Measure the indent in columns, then rebuild it. Empty lines
+        //  are left alone; lines of only blanks are shifted like the
+        //  others.
+        //
+        const gchar *p = line;
+        int col = 0;
+        while (p < line_end && isblank( *p ))
+        {
+            if (*p++ == '\t')
+                col = (col / tab_width + 1) * tab_width;
+            else
+                col++;
+        }
+
+        if (line < line_end)
+        {
+            col = std::max( col + shift, 0 );
+            if (use_spaces)
+            {
+                shifted.append( col, ' ' );
+            }
+            else
+            {
+                shifted.append( col / tab_width, '\t' );
+                shifted.append( col % tab_width, ' ' );
+            }
+        }
+
+        shifted.append( p, line_end - p );
+        if (nl)
+            shifted += '\n';
+
+        line = nl ? nl + 1 : NULL;
+    }
+
+    g_free( text );
+
+    buffer->begin_user_action();
+    start = buffer->erase( start, end );
+    buffer->insert( start, shifted.data(), shifted.data() + shifted.size() );
+    buffer->end_user_action();
+
+    set_cursor_at_line( buffer, last, false );
+
+    int n = last - first + 1;
+    if (n > 2)
+        get_vi()->show_message( "%d lines %ced %d time%s", n, shift_char,
+                                levels, levels == 1 ? "" : "s" );
+}
+
+void ex_make()
+{
+    std::string cmd = "make";
+    std::string args = get_vi()->get_cmd_params().raw();
+    if (!args.empty())
+        cmd += " " + args;
+
+    MainWindow *win = Application::get()->get_main_window();
+    BuildWindow *build = win->get_build_window();
+    Gtk::Notebook *area = win->get_info_area( MainWindow::Bottom );
+    area->set_current_page( area->page_num( *build ) );
+
+    build->run( cmd );
+}
+
+void ex_cnext( Direction dir )
+{
+    BuildWindow *build = Application::get()->get_main_window()->get_build_window();
+    if (build->get_entry_count() == 0)
+    {
+        get_vi()->show_error( "E42: No Errors" );
+        return;
+    }
+
+    int count = atoi( get_vi()->get_cmd_params().c_str() );
+    if (count < 1)
+        count = 1;
+
+    const BuildWindow::QuickfixEntry *entry = build->step( dir == Forward ? count : -count );
+    if (!entry)
+    {
+        get_vi()->show_error( "E553: No more items" );
+        return;
+    }
+
+    SourceEditor *editor = open_path( entry->file );
+    if (!editor)
+        return;
+
+    Gtk::TextView &view = editor->get_view();
+    Glib::RefPtr<Gtk::TextBuffer> buffer = view.get_buffer();
+
+    set_cursor_at_line( buffer, std::min( entry->line, get_last_line( buffer ) ), false );
+    if (entry->col > 1)
+    {
+        Gtk::TextIter iter = get_cursor_iter( buffer );
+        Gtk::TextIter line_end = iter;
+        if (!line_end.ends_line())
+            line_end.forward_to_line_end();
+
+        int n_chars = line_end.get_line_offset();
+        if (n_chars > 0)
+        {
+            iter.set_line_offset( std::min( entry->col - 1, n_chars - 1 ) );
+            set_cursor( iter, false );
+        }
+    }
+
+    view.grab_focus();
+    view.scroll_to( buffer->get_insert(), 0.25 );
+
+    get_vi()->show_message( "(%d of %d) %s", build->get_current() + 1,
+                            build->get_entry_count(), entry->message.c_str() );
+}
+
+void ex_nohlsearch()
+{
+    SearchHighlighter::hide();
+}
+
+void ex_perf()
+{
+    get_vi()->show_message( "%s", RegexCache::get()->get_report().c_str() );
+}
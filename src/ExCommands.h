@@ -0,0 +1,158 @@
+#ifndef EX_COMMANDS_H
+#define EX_COMMANDS_H
+
+#include <gtkmm.h>
+
+#include "Vi.h"
+
+//
+//  Ex commands that work on a range of lines. The range comes from
+//  ViKeyManager::get_cmd_range() and the arguments from
+//  get_cmd_params().
+//
+//  Each command reads the whole range with a single get_text() and
+//  changes it with a single erase/insert, inside one user action, so
+//  the cost doesn't depend on the number of lines and it is undone as
+//  one step.
+//
+
+/**
+ *  :[range]d[elete] [x] [count]
+ *
+ *  Deletes the lines into register x (or the current register).
+ */
+void ex_delete();
+
+/**
+ *  :[range]y[ank] [x] [count]
+ *
+ *  Yanks the lines into register x (or the current register).
+ */
+void ex_yank();
+
+/**
+ *  :[range]co[py] {address}  (also :t)
+ *
+ *  Puts a copy of the lines below {address}. 0 puts them above the
+ *  first line.
+ */
+void ex_copy();
+
+/**
+ *  :[range]m[ove] {address}
+ *
+ *  Moves the lines below {address}.
+ */
+void ex_move();
+
+/**
+ *  :[range]j[oin][!] [count]
+ *
+ *  Joins the lines, removing leading white space and putting a single
+ *  space between them. With ! the lines are joined as they are.
+ */
+void ex_join();
+
+/**
+ *  :[range]s[ubstitute]/{pattern}/{string}/[gciI] [count]
+ *
+ *  Replaces matches of {pattern} with {string}, which may refer to
+ *  groups with \1 - \9 and to the whole match with & (or \0).
+ *  Without g only the first match on each line is replaced; with c
+ *  each replacement is confirmed. Without a pattern, the last
+ *  substitution is repeated (also :&).
+ *
+ *  The replaced text is built in one pass over the range and swapped
+ *  into the buffer in one operation.
+ */
+void ex_substitute();
+
+/**
+ *  :[range]g[lobal][!]/{pattern}/[cmd]  and  :[range]v[global]/{pattern}/[cmd]
+ *
+ *  Runs the ex command cmd on each line that matches {pattern} (:g)
+ *  or doesn't match it (:v, or :g!). The range is the whole buffer by
+ *  default.
+ */
+void ex_global( bool invert );
+
+/**
+ *  :[range]sor[t][!] [n][u][r][i] [/{pattern}/]
+ *
+ *  Sorts the lines (the whole buffer by default). ! reverses the
+ *  order, n sorts on the first number in each line, u keeps only the
+ *  first of equal lines and i ignores case. With a pattern, lines sort
+ *  on what follows its match, or on the match itself with r.
+ */
+void ex_sort();
+
+/**
+ *  :[range]uniq
+ *
+ *  Removes all but the first of each set of equal lines (in the whole
+ *  buffer by default), keeping their order.
+ */
+void ex_uniq();
+
+/**
+ *  :{range}!{cmd}  filters the lines through {cmd}
+ *  :!{cmd}         runs {cmd}
+ */
+void ex_bang();
+
+/**
+ *  :[line]r[ead] !{cmd}  inserts the output of {cmd} below the line
+ *  :[line]r[ead] {file}  inserts the contents of {file}
+ */
+void ex_read();
+
+/**
+ *  :[range]w[rite] !{cmd}
+ *
+ *  Sends the lines (the whole buffer by default) to {cmd}. Without a
+ *  command, saves the file.
+ */
+void ex_write();
+
+/**
+ *  :[range]> [count]  and  :[range]< [count]
+ *
+ *  Shifts the lines right (or left) by one indent. Repeating the > or
+ *  < shifts by that many indents.
+ */
+void ex_shift( Direction dir );
+
+/**
+ *  :mak[e] [args]
+ *
+ *  Runs make in the background, showing its output in the Build page
+ *  of the bottom info area. Errors are collected into the quickfix
+ *  list as they are read.
+ */
+void ex_make();
+
+/**
+ *  :cn[ext] [count]  and  :cp[revious] [count]  (also :cN[ext])
+ *
+ *  Jumps to the next (or previous) entry in the quickfix list, opening
+ *  its file if need be.
+ */
+void ex_cnext( Direction dir );
+
+/**
+ *  :noh[lsearch]
+ *
+ *  Stops highlighting the matches of the last search until the next
+ *  one.
+ */
+void ex_nohlsearch();
+
+/**
+ *  :perf
+ *
+ *  Shows performance counters: for now, how well the compiled pattern
+ *  cache is doing.
+ */
+void ex_perf();
+
+#endif
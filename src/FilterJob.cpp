@@ -0,0 +1,451 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "FilterJob.h"
+#include "utils.h"
+
+//
+//  How long, in milliseconds, a cancelled command has to exit before it
+//  is killed outright.
+//
+const guint KILL_TIMEOUT = 1000;
+
+void FilterJob::start( Mode mode,
+                       const std::string &cmd,
+                       Glib::RefPtr<Gtk::TextBuffer> buffer,
+                       int first, int last )
+{
+    FilterJob *job = new FilterJob( mode, cmd, buffer );
+    if (!job->spawn( first, last ))
+        delete job;
+}
+
+FilterJob::FilterJob( Mode mode,
+                      const std::string &cmd,
+                      Glib::RefPtr<Gtk::TextBuffer> buffer ) :
+    m_mode(mode),
+    m_cmd(cmd),
+    m_buffer(buffer),
+    m_pid(0),
+    m_in_fd(-1),
+    m_out_fd(-1),
+    m_err_fd(-1),
+    m_exited(false),
+    m_status(0),
+    m_cancelled(false),
+    m_trim_newline(false),
+    m_written(0),
+    m_n_read(0)
+{
+}
+
+FilterJob::~FilterJob()
+{
+    m_in_watch.disconnect();
+    m_out_watch.disconnect();
+    m_err_watch.disconnect();
+    m_cancel.disconnect();
+    m_kill_timer.disconnect();
+
+    if (m_in_fd >= 0)
+        close( m_in_fd );
+    if (m_out_fd >= 0)
+        close( m_out_fd );
+    if (m_err_fd >= 0)
+        close( m_err_fd );
+
+    if (m_start)
+        m_buffer->delete_mark( m_start );
+    if (m_end)
+        m_buffer->delete_mark( m_end );
+}
+
+bool FilterJob::spawn( int first, int last )
+{
+    //
+    //  A command that stops reading its input mustn't kill the editor.
+    //
+    static bool sigpipe_ignored = false;
+    if (!sigpipe_ignored)
+    {
+        signal( SIGPIPE, SIG_IGN );
+        sigpipe_ignored = true;
+    }
+
+    Gtk::TextIter start, end;
+    if (m_mode == filter_lines || m_mode == write_lines)
+    {
+        start = m_buffer->get_iter_at_line( first - 1 );
+        end = m_buffer->get_iter_at_line( last - 1 );
+        end.forward_line();
+
+        gchar *text = gtk_text_buffer_get_text( m_buffer->gobj(), start.gobj(),
+                                                end.gobj(), TRUE );
+        m_input.assign( text );
+        g_free( text );
+
+        if (!m_input.empty() && m_input[m_input.size() - 1] != '\n')
+        {
+            m_input += '\n';
+            m_trim_newline = true;
+        }
+    }
+    else if (m_mode == read_output)
+    {
+        //
+        //  Line 0 (":0r !cmd") reads in above the first line.
+        //
+        if (last == 0)
+        {
+            start = m_buffer->begin();
+        }
+        else
+        {
+            start = m_buffer->get_iter_at_line( last - 1 );
+            start.forward_line();
+        }
+        if (start.is_end() && !start.starts_line())
+            m_trim_newline = true;
+    }
+
+    gchar *argv[] = { (gchar*)"/bin/sh", (gchar*)"-c", (gchar*)m_cmd.c_str(), NULL };
+    GError *error = NULL;
+
+    if (!g_spawn_async_with_pipes( NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                                   set_process_group, NULL, &m_pid,
+                                   &m_in_fd, &m_out_fd, &m_err_fd, &error ))
+    {
+        get_vi()->show_error( "Couldn't run %s: %s", m_cmd.c_str(), error->message );
+        g_error_free( error );
+        return false;
+    }
+
+    int fds[] = { m_in_fd, m_out_fd, m_err_fd };
+    for (int i = 0; i < 3; ++i)
+        fcntl( fds[i], F_SETFL, fcntl( fds[i], F_GETFL ) | O_NONBLOCK );
+
+    if (m_input.empty())
+    {
+        close( m_in_fd );
+        m_in_fd = -1;
+    }
+    else
+    {
+        m_in_watch = Glib::signal_io().connect(
+                    sigc::mem_fun( *this, &FilterJob::on_input ), m_in_fd,
+                    Glib::IO_OUT | Glib::IO_ERR | Glib::IO_HUP );
+    }
+
+    m_out_watch = Glib::signal_io().connect(
+                sigc::mem_fun( *this, &FilterJob::on_output ), m_out_fd,
+                Glib::IO_IN | Glib::IO_ERR | Glib::IO_HUP );
+    m_err_watch = Glib::signal_io().connect(
+                sigc::mem_fun( *this, &FilterJob::on_error ), m_err_fd,
+                Glib::IO_IN | Glib::IO_ERR | Glib::IO_HUP );
+    g_child_watch_add( m_pid, on_child_exit, this );
+
+    //
+    //  The lines being filtered are taken out now; the output goes in
+    //  between the marks as it arrives.
+    //
+    if (m_mode == filter_lines || m_mode == read_output)
+    {
+        m_buffer->begin_user_action();
+
+        m_start = m_buffer->create_mark( start, true );
+        if (m_mode == filter_lines)
+            start = m_buffer->erase( start, end );
+        m_end = m_buffer->create_mark( start, false );
+    }
+
+    get_vi()->hold_input();
+    m_cancel = get_vi()->signal_cancel().connect(
+                sigc::mem_fun( *this, &FilterJob::on_cancel ) );
+
+    get_vi()->show_message( "Running %s...", m_cmd.c_str() );
+
+    return true;
+}
+
+//
+// Protected
+//
+bool FilterJob::on_input( Glib::IOCondition cond )
+{
+    if (!(cond & Glib::IO_OUT))
+    {
+        close( m_in_fd );
+        m_in_fd = -1;
+        return false;
+    }
+
+    gsize n = m_input.size() - m_written;
+    if (n > IO_SIZE)
+        n = IO_SIZE;
+    gssize written = write( m_in_fd, m_input.data() + m_written, n );
+
+    if (written < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return true;
+
+        //
+        //  The command stopped reading (EPIPE); that's up to it.
+        //
+        close( m_in_fd );
+        m_in_fd = -1;
+        return false;
+    }
+
+    m_written += written;
+    if (m_written < m_input.size())
+        return true;
+
+    close( m_in_fd );
+    m_in_fd = -1;
+    return false;
+}
+
+bool FilterJob::on_output( Glib::IOCondition cond )
+{
+    gchar buf[IO_SIZE];
+    gssize n = read( m_out_fd, buf, sizeof(buf) );
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return true;
+
+    if (n <= 0)
+    {
+        close( m_out_fd );
+        m_out_fd = -1;
+        finish();
+        return false;
+    }
+
+    add_output( buf, n );
+    return true;
+}
+
+bool FilterJob::on_error( Glib::IOCondition cond )
+{
+    gchar buf[4096];
+    gssize n = read( m_err_fd, buf, sizeof(buf) );
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return true;
+
+    if (n <= 0)
+    {
+        close( m_err_fd );
+        m_err_fd = -1;
+        finish();
+        return false;
+    }
+
+    if (m_errors.size() < 4096)
+        m_errors.append( buf, n );
+    return true;
+}
+
+void FilterJob::on_cancel()
+{
+    if (m_cancelled)
+        return;
+
+    m_cancelled = true;
+    kill( -m_pid, SIGTERM );
+    m_kill_timer = Glib::signal_timeout().connect(
+                sigc::mem_fun( *this, &FilterJob::on_kill_timeout ), KILL_TIMEOUT );
+
+    //
+    //  Stop listening to the command; only its exit is waited for.
+    //
+    m_in_watch.disconnect();
+    m_out_watch.disconnect();
+    m_err_watch.disconnect();
+
+    int *fds[] = { &m_in_fd, &m_out_fd, &m_err_fd };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (*fds[i] >= 0)
+        {
+            close( *fds[i] );
+            *fds[i] = -1;
+        }
+    }
+
+    restore();
+    finish();
+}
+
+bool FilterJob::on_kill_timeout()
+{
+    if (!m_exited)
+        kill( -m_pid, SIGKILL );
+    return false;
+}
+
+void FilterJob::add_output( const gchar *data, gsize len )
+{
+    m_n_read += len;
+
+    if (m_mode == write_lines || m_mode == run_command)
+    {
+        //
+        //  Only the last line of the output is shown.
+        //
+        m_last_line.append( data, len );
+
+        std::string::size_type end = m_last_line.find_last_not_of( '\n' );
+        if (end != std::string::npos)
+        {
+            std::string::size_type nl = m_last_line.rfind( '\n', end );
+            if (nl != std::string::npos)
+                m_last_line.erase( 0, nl + 1 );
+        }
+        if (m_last_line.size() > 1024)
+            m_last_line.erase( 0, m_last_line.size() - 1024 );
+        return;
+    }
+
+    //
+    //  Insert up to the last complete UTF-8 character; a partial one is
+    //  kept for the next read.
+    //
+    m_partial.append( data, len );
+
+    gsize complete = m_partial.size();
+    gsize lead = complete;
+    while (lead > 0 && complete - lead < 3 && ((guchar)m_partial[lead - 1] & 0xC0) == 0x80)
+        lead--;
+    if (lead > 0 && ((guchar)m_partial[lead - 1] & 0xC0) == 0xC0)
+    {
+        lead--;
+        if (lead + g_utf8_skip[(guchar)m_partial[lead]] > complete)
+            complete = lead;
+    }
+
+    if (!g_utf8_validate( m_partial.data(), complete, NULL ))
+    {
+        m_errors = "The output isn't valid UTF-8";
+        on_cancel();
+        return;
+    }
+
+    Gtk::TextIter iter = m_buffer->get_iter_at_mark( m_end );
+    m_buffer->insert( iter, m_partial.data(), m_partial.data() + complete );
+    m_partial.erase( 0, complete );
+
+    get_vi()->show_message( "Running %s... %lu KB", m_cmd.c_str(),
+                            (unsigned long)(m_n_read / 1024) );
+}
+
+void FilterJob::restore()
+{
+    if (m_mode != filter_lines && m_mode != read_output)
+        return;
+
+    Gtk::TextIter start = m_buffer->get_iter_at_mark( m_start );
+    Gtk::TextIter end = m_buffer->get_iter_at_mark( m_end );
+    start = m_buffer->erase( start, end );
+
+    if (m_trim_newline && m_mode == filter_lines)
+        m_buffer->insert( start, m_input.data(), m_input.data() + m_input.size() - 1 );
+    else
+        m_buffer->insert( start, m_input.data(), m_input.data() + m_input.size() );
+
+    m_partial.clear();
+}
+
+void FilterJob::finish()
+{
+    if (!m_exited || m_out_fd >= 0 || m_err_fd >= 0)
+        return;
+
+    bool failed = !m_cancelled &&
+                  (!WIFEXITED( m_status ) || WEXITSTATUS( m_status ) != 0);
+
+    if (m_mode == filter_lines || m_mode == read_output)
+    {
+        if (failed)
+        {
+            restore();
+        }
+        else if (!m_cancelled)
+        {
+            //
+            //  Keep the buffer's last line without a newline, and make
+            //  sure output read into the last line starts on a new one.
+            //
+            Gtk::TextIter start = m_buffer->get_iter_at_mark( m_start );
+            Gtk::TextIter end = m_buffer->get_iter_at_mark( m_end );
+            if (m_trim_newline && end.is_end() && start != end)
+            {
+                Gtk::TextIter before = end;
+                before.backward_char();
+                if (before.get_char() == '\n')
+                    m_buffer->erase( before, end );
+
+                if (m_mode == read_output)
+                    m_buffer->insert( m_buffer->get_iter_at_mark( m_start ), "\n" );
+            }
+        }
+
+        m_buffer->end_user_action();
+
+        Gtk::TextIter iter = m_buffer->get_iter_at_mark( m_start );
+        if (!iter.starts_line())
+            iter.forward_line();
+        set_cursor( iter, false );
+    }
+
+    if (m_cancelled && m_errors.empty())
+    {
+        get_vi()->show_error( "Interrupted" );
+    }
+    else if (m_cancelled || failed)
+    {
+        std::string first_line = m_errors.substr( 0, m_errors.find( '\n' ) );
+        if (WIFEXITED( m_status ))
+            get_vi()->show_error( "shell returned %d: %s",
+                                  WEXITSTATUS( m_status ), first_line.c_str() );
+        else
+            get_vi()->show_error( "%s", first_line.c_str() );
+    }
+    else if (m_mode == write_lines || m_mode == run_command)
+    {
+        std::string::size_type end = m_last_line.find_last_not_of( '\n' );
+        get_vi()->show_message( "%s", m_last_line.substr( 0, end + 1 ).c_str() );
+    }
+    else
+    {
+        get_vi()->show_message( "" );
+    }
+
+    get_vi()->release_input();
+    delete this;
+}
+
+void FilterJob::on_child_exit( GPid pid, gint status, gpointer data )
+{
+    FilterJob *self = static_cast<FilterJob*>( data );
+
+    g_spawn_close_pid( pid );
+    self->m_exited = true;
+    self->m_status = status;
+    self->finish();
+}
+
+//
+//  Runs in the child before exec. The command gets its own process
+//  group, so cancelling kills everything it started.
+//
+void FilterJob::set_process_group( gpointer data )
+{
+    setpgid( 0, 0 );
+}
@@ -0,0 +1,104 @@
+#ifndef SOURCERER_FILTER_JOB_H
+#define SOURCERER_FILTER_JOB_H
+
+#include <string>
+
+#include <gtkmm.h>
+
+/**
+ *  Runs a shell command for :!, :r !cmd and :w !cmd.
+ *
+ *  The command's standard input and output are non-blocking pipes
+ *  watched from the main loop: input is written as the pipe accepts
+ *  it and output is read as it arrives, so neither side can fill up
+ *  and block the other, and the window keeps redrawing.
+ *
+ *  When filtering, the lines are removed up front and the output is
+ *  inserted in their place as it is read, all in one user action (and
+ *  so one undo step). Key presses are held until the command is done;
+ *  <Esc> kills it and puts the original lines back.
+ *
+ *  Jobs delete themselves when they are done.
+ */
+class FilterJob
+{
+    public:
+        enum Mode
+        {
+            filter_lines,       // replace the lines with the output
+            read_output,        // insert the output below the lines
+            write_lines,        // send the lines, show the output
+            run_command         // no input, show the output
+        };
+
+        /**
+         *  The most bytes written or read in one go.
+         */
+        static const gsize IO_SIZE = 64 * 1024;
+
+        /**
+         *  Starts cmd. For read_output only last is used (0 reads the
+         *  output in above the first line); for run_command the lines
+         *  aren't used at all.
+         */
+        static void start( Mode mode,
+                           const std::string &cmd,
+                           Glib::RefPtr<Gtk::TextBuffer> buffer,
+                           int first, int last );
+
+    protected:
+        FilterJob( Mode mode,
+                   const std::string &cmd,
+                   Glib::RefPtr<Gtk::TextBuffer> buffer );
+        ~FilterJob();
+
+        bool spawn( int first, int last );
+
+        bool on_input( Glib::IOCondition cond );
+        bool on_output( Glib::IOCondition cond );
+        bool on_error( Glib::IOCondition cond );
+        void on_cancel();
+
+        bool on_kill_timeout();
+
+        void add_output( const gchar *data, gsize len );
+        void restore();
+        void finish();
+
+        static void on_child_exit( GPid pid, gint status, gpointer data );
+        static void set_process_group( gpointer data );
+
+        Mode m_mode;
+        std::string m_cmd;
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_start;    // left gravity
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_end;      // right gravity
+
+        GPid m_pid;
+        int m_in_fd;
+        int m_out_fd;
+        int m_err_fd;
+        bool m_exited;
+        gint m_status;
+        bool m_cancelled;
+
+        sigc::connection m_in_watch;
+        sigc::connection m_out_watch;
+        sigc::connection m_err_watch;
+        sigc::connection m_cancel;
+        sigc::connection m_kill_timer;
+
+        std::string m_input;            // the original lines
+        bool m_trim_newline;            // the last line had no newline
+        gsize m_written;
+        std::string m_partial;          // an incomplete UTF-8 sequence
+        std::string m_errors;
+        std::string m_last_line;        // of the output, when it is shown
+        gsize m_n_read;
+
+    private:
+        FilterJob( const FilterJob& );
+        FilterJob& operator=( const FilterJob& );
+};
+
+#endif
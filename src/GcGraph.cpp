@@ -0,0 +1,113 @@
+#include <cstdio>
+
+#include "GcGraph.h"
+
+//
+//  One frame at 60Hz, in seconds.
+//
+static const double FRAME_TIME = 1.0 / 60;
+
+GcGraph::GcGraph() :
+    m_max_pause(0.0)
+{
+    set_size_request( -1, 64 );
+}
+
+GcGraph::~GcGraph()
+{
+}
+
+void GcGraph::add_records( const std::vector<s7_gc_record> &records )
+{
+    for (guint i = 0; i < records.size(); ++i)
+    {
+        m_records.push_back( records[i] );
+        if (records[i].pause > m_max_pause)
+            m_max_pause = records[i].pause;
+    }
+
+    while (m_records.size() > HISTORY_SIZE)
+        m_records.pop_front();
+
+    queue_draw();
+}
+
+//
+// Protected
+//
+bool GcGraph::on_expose_event( GdkEventExpose *event )
+{
+    Glib::RefPtr<Gdk::Window> window = get_window();
+    Glib::RefPtr<Gtk::Style> style = get_style();
+    Gtk::StateType state = get_state();
+
+    int width, height;
+    window->get_size( width, height );
+    window->draw_rectangle( style->get_base_gc( state ), true, 0, 0, width, height );
+
+    Glib::RefPtr<Pango::Layout> layout;
+    if (m_records.empty())
+    {
+        layout = create_pango_layout( "No garbage collections yet" );
+    }
+    else
+    {
+        const s7_gc_record &last = m_records.back();
+        char summary[256];
+        snprintf( summary, sizeof(summary),
+                  "GC %u: pause %.2f ms (max %.2f ms), sweep %.2f ms, "
+                  "%u of %u cells live, %.1fM cells/s allocated",
+                  last.number, last.pause * 1000.0, m_max_pause * 1000.0,
+                  last.sweep * 1000.0, last.live, last.heap_size,
+                  last.alloc_rate / 1000000.0 );
+        layout = create_pango_layout( summary );
+    }
+
+    int text_width, text_height;
+    layout->get_pixel_size( text_width, text_height );
+    window->draw_layout( style->get_text_gc( state ), 4, 2, layout );
+
+    //
+    //  The bars share the space below the summary, scaled so the
+    //  frame line and the tallest bar both fit.
+    //
+    int top = text_height + 4;
+    int graph_height = height - top - 2;
+    if (graph_height <= 0)
+        return true;
+
+    double scale = FRAME_TIME;
+    for (guint i = 0; i < m_records.size(); ++i)
+    {
+        double total = m_records[i].pause + m_records[i].sweep;
+        if (total > scale)
+            scale = total;
+    }
+
+    int bar_width = width / HISTORY_SIZE;
+    if (bar_width < 2)
+        bar_width = 2;
+
+    int x = width - bar_width * (int)m_records.size();
+    for (guint i = 0; i < m_records.size(); ++i, x += bar_width)
+    {
+        int pause = (int)(graph_height * m_records[i].pause / scale + 0.5);
+        int sweep = (int)(graph_height * m_records[i].sweep / scale + 0.5);
+        if (pause < 1)
+            pause = 1;
+
+        int y = height - 2 - pause;
+        window->draw_rectangle( style->get_fg_gc( state ), true,
+                                x, y, bar_width - 1, pause );
+        if (sweep > 0)
+        {
+            window->draw_rectangle( style->get_mid_gc( state ), true,
+                                    x, y - sweep, bar_width - 1, sweep );
+        }
+    }
+
+    int frame_y = height - 2 - (int)(graph_height * FRAME_TIME / scale + 0.5);
+    window->draw_line( style->get_dark_gc( state ), 0, frame_y, width, frame_y );
+
+    return true;
+}
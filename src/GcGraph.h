@@ -0,0 +1,41 @@
+#ifndef SOURCERER_GC_GRAPH_H
+#define SOURCERER_GC_GRAPH_H
+
+#include <deque>
+#include <vector>
+
+#include <gtkmm.h>
+
+#include "s7.h"
+
+/**
+ *  A strip under the REPL graphing the Scheme interpreter's recent
+ *  garbage collections, one bar per collection, so a hitch in the
+ *  editor can be matched with a collection.
+ *
+ *  Each bar is the collection's pause, with its sweep (spread over the
+ *  allocations that followed) stacked on top in a lighter shade. The
+ *  line across is one frame at 60Hz. The latest collection is
+ *  summarised above the bars.
+ */
+class GcGraph : public Gtk::DrawingArea
+{
+    public:
+        /**
+         *  How many collections are graphed.
+         */
+        static const guint HISTORY_SIZE = 120;
+
+        GcGraph();
+        virtual ~GcGraph();
+
+        void add_records( const std::vector<s7_gc_record> &records );
+
+    protected:
+        virtual bool on_expose_event( GdkEventExpose *event );
+
+        std::deque<s7_gc_record> m_records;     // oldest first
+        double m_max_pause;                     // seconds, over all of them
+};
+
+#endif
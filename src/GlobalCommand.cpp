@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ExCommandLine.h"
+#include "GlobalCommand.h"
+#include "RegexCache.h"
+#include "utils.h"
+
+bool GlobalCommand::s_running = false;
+
+GlobalCommand::GlobalCommand( Glib::RefPtr<Gtk::TextBuffer> buffer ) :
+    m_buffer(buffer),
+    m_next(0),
+    m_shift(0)
+{
+}
+
+GlobalCommand::~GlobalCommand()
+{
+}
+
+bool GlobalCommand::mark_lines( const std::string &pattern, int first, int last,
+                                bool invert )
+{
+    m_lines.clear();
+    m_next = 0;
+    m_shift = 0;
+
+    GError *error = NULL;
+    GRegex *regex = RegexCache::get()->compile( pattern, G_REGEX_MULTILINE, &error );
+    if (error)
+    {
+        m_error = error->message;
+        g_error_free( error );
+        return false;
+    }
+
+    Gtk::TextIter start = m_buffer->get_iter_at_line( first - 1 );
+    Gtk::TextIter end = m_buffer->get_iter_at_line( last - 1 );
+    if (!end.ends_line())
+        end.forward_to_line_end();
+
+    gchar *text = gtk_text_buffer_get_text( m_buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+    gsize len = strlen( text );
+
+    //
+    //  Find the first match on each line, then carry on from the start
+    //  of the next one. Line numbers are counted as we go.
+    //
+    int line = first - 1;
+    int next_unmatched = line;
+    const gchar *counted = text;
+
+    GMatchInfo *match_info;
+    g_regex_match_full( regex, text, len, 0, (GRegexMatchFlags)0, &match_info, NULL );
+
+    while (g_match_info_matches( match_info ))
+    {
+        gint match_start, match_end;
+        g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+
+        const gchar *p = counted;
+        while ((p = (const gchar*)memchr( p, '\n', text + match_start - p )) != NULL)
+        {
+            line++;
+            p++;
+        }
+        counted = text + match_start;
+
+        if (invert)
+        {
+            for (; next_unmatched < line; ++next_unmatched)
+                m_lines.push_back( next_unmatched );
+            next_unmatched = line + 1;
+        }
+        else
+        {
+            m_lines.push_back( line );
+        }
+
+        const gchar *nl = (const gchar*)memchr( text + match_start, '\n',
+                                                len - match_start );
+        g_match_info_free( match_info );
+        if (!nl)
+        {
+            match_info = NULL;
+            break;
+        }
+
+        line++;
+        counted = nl + 1;
+        g_regex_match_full( regex, text, len, counted - text, (GRegexMatchFlags)0,
+                            &match_info, NULL );
+    }
+
+    if (match_info)
+        g_match_info_free( match_info );
+
+    if (invert)
+    {
+        for (; next_unmatched < last; ++next_unmatched)
+            m_lines.push_back( next_unmatched );
+    }
+
+    g_free( text );
+    g_regex_unref( regex );
+
+    return true;
+}
+
+void GlobalCommand::run( const Glib::ustring &cmd )
+{
+    if (m_lines.empty())
+        return;
+
+    s_running = true;
+    m_buffer->begin_user_action();
+
+    char reg;
+    if (is_delete( cmd, reg ))
+    {
+        delete_lines( reg );
+    }
+    else
+    {
+        GtkTextBuffer *b = m_buffer->gobj();
+        gulong insert_handler = g_signal_connect( b, "insert-text",
+                                                  G_CALLBACK( on_insert_text ), this );
+        gulong delete_handler = g_signal_connect( b, "delete-range",
+                                                  G_CALLBACK( on_delete_range ), this );
+
+        while (m_next < m_lines.size())
+        {
+            int line = m_lines[m_next++];
+            if (line == DELETED)
+                continue;
+
+            set_cursor_at_line( m_buffer, line + m_shift + 1, false );
+            if (!get_vi()->execute_command( cmd ))
+                break;
+        }
+
+        g_signal_handler_disconnect( b, insert_handler );
+        g_signal_handler_disconnect( b, delete_handler );
+    }
+
+    m_buffer->end_user_action();
+    s_running = false;
+}
+
+//
+// Protected
+//
+
+//
+//  Returns true if cmd is a plain ":d[elete] [x]", setting reg to the
+//  register to use.
+//
+bool GlobalCommand::is_delete( const Glib::ustring &cmd, char &reg )
+{
+    ExCommandLine ex;
+    if (!ex.parse( cmd, m_buffer ) || ex.get_addr_count() != 0)
+        return false;
+
+    std::string name = ex.get_name().raw();
+    std::string args = ex.get_args().raw();
+    if (name.empty() || std::string( "delete" ).compare( 0, name.size(), name ) != 0)
+        return false;
+
+    if (args.empty())
+        reg = get_vi()->get_current_register();
+    else if (args.size() == 1 && !isdigit( args[0] ))
+        reg = args[0];
+    else
+        return false;
+
+    return true;
+}
+
+//
+//  Deletes all of the marked lines. The span from the first to the
+//  last marked line is rebuilt without them and swapped in with one
+//  edit; the deleted lines go into register reg.
+//
+void GlobalCommand::delete_lines( char reg )
+{
+    int first = m_lines.front();
+    int last = m_lines.back();
+
+    Gtk::TextIter start = m_buffer->get_iter_at_line( first );
+    Gtk::TextIter end = m_buffer->get_iter_at_line( last );
+    end.forward_line();
+
+    gchar *text = gtk_text_buffer_get_text( m_buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+    gsize len = strlen( text );
+
+    std::string kept;
+    GString *deleted = g_string_sized_new( len / 2 );
+
+    const gchar *p = text;
+    const gchar *text_end = text + len;
+    int line = first;
+    gsize idx = 0;
+    while (p < text_end)
+    {
+        //
+        //  Copy runs of adjacent lines at a time.
+        //
+        bool marked = (idx < m_lines.size() && m_lines[idx] == line);
+        const gchar *run_start = p;
+        do
+        {
+            const gchar *nl = (const gchar*)memchr( p, '\n', text_end - p );
+            p = nl ? nl + 1 : text_end;
+            line++;
+            if (marked)
+                idx++;
+        } while (p < text_end &&
+                 marked == (idx < m_lines.size() && m_lines[idx] == line));
+
+        if (marked)
+            g_string_append_len( deleted, run_start, p - run_start );
+        else
+            kept.append( run_start, p - run_start );
+    }
+    g_free( text );
+
+    //
+    //  If the last line of the buffer has no newline, the newline
+    //  before it goes instead.
+    //
+    if (end.is_end() && !end.starts_line())
+    {
+        g_string_append_c( deleted, '\n' );
+        if (!kept.empty())
+            kept.erase( kept.size() - 1 );
+        else if (!start.is_start())
+            start.backward_char();
+    }
+
+    int n_deleted = m_lines.size();
+
+    start = m_buffer->erase( start, end );
+    m_buffer->insert( start, kept.data(), kept.data() + kept.size() );
+
+    gsize n_bytes = deleted->len;
+    get_vi()->set_register( reg, ViTextChunk::create( g_string_free( deleted, FALSE ), n_bytes ),
+                            vi_linewise );
+
+    set_cursor_at_line( m_buffer, std::min( first + 1, get_last_line( m_buffer ) ), false );
+
+    if (n_deleted > 2)
+        get_vi()->show_message( "%d fewer lines", n_deleted );
+}
+
+//
+//  Lines from 'from' to 'deleted_to' (from 0, actual line numbers)
+//  were deleted, and the lines after them moved by delta.
+//
+void GlobalCommand::track( int from, int deleted_to, int delta )
+{
+    gsize i = m_next;
+    bool skipped = false;
+    while (i < m_lines.size() &&
+           (m_lines[i] == DELETED || m_lines[i] + m_shift < from))
+    {
+        if (m_lines[i] != DELETED)
+            skipped = true;
+        i++;
+    }
+
+    for (; i < m_lines.size(); ++i)
+    {
+        if (m_lines[i] == DELETED)
+            continue;
+
+        if (m_lines[i] + m_shift <= deleted_to)
+            m_lines[i] = DELETED;
+        else if (skipped)
+            m_lines[i] += delta;
+        else
+            break;
+    }
+
+    //
+    //  The usual case: the change is above all of the lines left, so
+    //  they all move together.
+    //
+    if (!skipped)
+        m_shift += delta;
+}
+
+void GlobalCommand::on_insert_text( GtkTextBuffer *buffer, GtkTextIter *location,
+                                    gchar *text, gint len, GlobalCommand *self )
+{
+    int n = 0;
+    for (const gchar *p = text; (p = (const gchar*)memchr( p, '\n', text + len - p )); ++p)
+        n++;
+
+    if (n == 0)
+        return;
+
+    //
+    //  Lines from the insert position down move by n.
+    //
+    int line = gtk_text_iter_get_line( location );
+    if (!gtk_text_iter_starts_line( location ))
+        line++;
+
+    self->track( line, line - 1, n );
+}
+
+void GlobalCommand::on_delete_range( GtkTextBuffer *buffer, GtkTextIter *start,
+                                     GtkTextIter *end, GlobalCommand *self )
+{
+    int line1 = gtk_text_iter_get_line( start );
+    int line2 = gtk_text_iter_get_line( end );
+    int n = line2 - line1;
+
+    if (n == 0)
+        return;
+
+    //
+    //  From the start of a line, lines line1 .. line2-1 go; from the
+    //  middle of one, the following lines are joined onto it.
+    //
+    if (gtk_text_iter_starts_line( start ))
+        self->track( line1, line2 - 1, -n );
+    else
+        self->track( line1 + 1, line2, -n );
+}
@@ -0,0 +1,83 @@
+#ifndef SOURCERER_GLOBAL_COMMAND_H
+#define SOURCERER_GLOBAL_COMMAND_H
+
+#include <string>
+#include <vector>
+
+#include <gtkmm.h>
+
+/**
+ *  Runs an ex command on every line that matches a pattern (:g), or
+ *  that doesn't (:v).
+ *
+ *  The lines are found first, in a single pass over the range. The
+ *  command is then run with the cursor on each marked line in turn.
+ *  Marked line numbers are kept up to date as the command inserts and
+ *  deletes text, and lines it deletes are skipped.
+ *
+ *  Deleting the marked lines is done without running a command per
+ *  line: adjacent lines are merged and the remaining text is swapped
+ *  in with a single edit.
+ */
+class GlobalCommand
+{
+    public:
+        GlobalCommand( Glib::RefPtr<Gtk::TextBuffer> buffer );
+        virtual ~GlobalCommand();
+
+        /**
+         *  Marks the lines from first to last (from 1) that match
+         *  pattern, or that don't if invert is true. Returns false,
+         *  and sets the error message, if the pattern is invalid.
+         */
+        bool mark_lines( const std::string &pattern, int first, int last,
+                         bool invert );
+
+        gsize get_n_marked() const { return m_lines.size(); }
+
+        /**
+         *  Runs the ex command cmd on each marked line.
+         */
+        void run( const Glib::ustring &cmd );
+
+        const Glib::ustring& get_error() const { return m_error; }
+
+        /**
+         *  Returns true while a :g command is running; they can't be
+         *  nested.
+         */
+        static bool is_running() { return s_running; }
+
+    protected:
+        static const int DELETED = -1;
+
+        bool is_delete( const Glib::ustring &cmd, char &reg );
+        void delete_lines( char reg );
+
+        void track( int from, int deleted_to, int delta );
+
+        static void on_insert_text( GtkTextBuffer *buffer, GtkTextIter *location,
+                                    gchar *text, gint len, GlobalCommand *self );
+        static void on_delete_range( GtkTextBuffer *buffer, GtkTextIter *start,
+                                     GtkTextIter *end, GlobalCommand *self );
+
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        Glib::ustring m_error;
+
+        //
+        //  Marked lines (from 0), in order. Lines from m_next on are
+        //  still to be run and are at m_lines[i] + m_shift, unless
+        //  DELETED.
+        //
+        std::vector<int> m_lines;
+        gsize m_next;
+        int m_shift;
+
+        static bool s_running;
+
+    private:
+        GlobalCommand( const GlobalCommand& );
+        GlobalCommand& operator=( const GlobalCommand& );
+};
+
+#endif
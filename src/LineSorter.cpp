@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "LineSorter.h"
+#include "RegexCache.h"
+
+LineSorter::LineSorter( int flags ) :
+    m_flags(flags),
+    m_regex(NULL)
+{
+}
+
+LineSorter::~LineSorter()
+{
+    if (m_regex)
+        g_regex_unref( m_regex );
+}
+
+bool LineSorter::set_pattern( const std::string &pattern )
+{
+    int compile_flags = 0;
+    if (m_flags & sort_ignore_case)
+        compile_flags |= G_REGEX_CASELESS;
+
+    GError *error = NULL;
+    m_regex = RegexCache::get()->compile( pattern, compile_flags, &error );
+    if (error)
+    {
+        m_error = error->message;
+        g_error_free( error );
+        return false;
+    }
+    return true;
+}
+
+void LineSorter::sort( const gchar *text, gsize len, std::string &out )
+{
+    split_lines( text, len, m_lines );
+
+    gsize n = m_lines.size();
+    guint n_threads = (n >= PARALLEL_MIN) ? get_n_threads() : 1;
+
+    if (n_threads == 1)
+    {
+        sort_chunk( 0, n );
+    }
+    else
+    {
+        std::vector<gsize> bounds;
+        for (guint i = 0; i <= n_threads; ++i)
+            bounds.push_back( n * i / n_threads );
+
+        std::vector<Glib::Thread*> threads;
+        for (guint i = 0; i < n_threads; ++i)
+        {
+            threads.push_back( Glib::Thread::create(
+                        sigc::bind( sigc::mem_fun( *this, &LineSorter::sort_chunk ),
+                                    bounds[i], bounds[i + 1] ),
+                        true ) );
+        }
+        for (guint i = 0; i < threads.size(); ++i)
+            threads[i]->join();
+
+        //
+        //  Merge the sorted runs in pairs until one is left. The pairs
+        //  at each level are merged at the same time.
+        //
+        m_merged.resize( n );
+        while (bounds.size() > 2)
+        {
+            gsize n_runs = bounds.size() - 1;
+            std::vector<gsize> next_bounds;
+
+            threads.clear();
+            for (gsize i = 0; i + 1 < n_runs; i += 2)
+            {
+                threads.push_back( Glib::Thread::create(
+                            sigc::bind( sigc::mem_fun( *this, &LineSorter::merge_runs ),
+                                        bounds[i], bounds[i + 1], bounds[i + 2] ),
+                            true ) );
+                next_bounds.push_back( bounds[i] );
+            }
+            if (n_runs % 2)
+                next_bounds.push_back( bounds[n_runs - 1] );
+            next_bounds.push_back( n );
+
+            for (guint i = 0; i < threads.size(); ++i)
+                threads[i]->join();
+
+            bounds.swap( next_bounds );
+        }
+        m_merged.clear();
+    }
+
+    //
+    //  Write the lines out in their new order.
+    //
+    Compare less( m_flags );
+    bool unique = (m_flags & sort_unique);
+
+    out.clear();
+    out.reserve( len + 1 );
+    for (gsize i = 0; i < n; ++i)
+    {
+        const Line &line = m_lines[i];
+        if (unique && i > 0 && !less( m_lines[i - 1], line ) && !less( line, m_lines[i - 1] ))
+            continue;
+
+        if (i > 0)
+            out += '\n';
+        out.append( line.data, line.len );
+    }
+
+    m_lines.clear();
+}
+
+void LineSorter::uniq( const gchar *text, gsize len, std::string &out )
+{
+    std::vector<Line> lines;
+    split_lines( text, len, lines );
+
+    GHashTable *seen = g_hash_table_new( hash_line, equal_lines );
+
+    out.clear();
+    out.reserve( len + 1 );
+    for (gsize i = 0; i < lines.size(); ++i)
+    {
+        Line *line = &lines[i];
+        if (g_hash_table_lookup( seen, line ))
+            continue;
+
+        g_hash_table_insert( seen, line, line );
+
+        if (i > 0)
+            out += '\n';
+        out.append( line->data, line->len );
+    }
+
+    g_hash_table_destroy( seen );
+}
+
+//
+// Protected
+//
+bool LineSorter::Compare::operator()( const Line &a, const Line &b ) const
+{
+    int r = compare( a, b );
+    return (m_flags & sort_reverse) ? r > 0 : r < 0;
+}
+
+int LineSorter::Compare::compare( const Line &a, const Line &b ) const
+{
+    //
+    //  Lines without a key (no match, or no number) come first.
+    //
+    if (!a.key || !b.key)
+        return (a.key != NULL) - (b.key != NULL);
+
+    if (m_flags & sort_numeric)
+    {
+        if (a.has_number != b.has_number)
+            return (int)a.has_number - (int)b.has_number;
+        if (!a.has_number)
+            return 0;
+        return (a.number > b.number) - (a.number < b.number);
+    }
+
+    gsize n = std::min( a.key_len, b.key_len );
+    int r = (m_flags & sort_ignore_case) ? g_ascii_strncasecmp( a.key, b.key, n )
+                                         : memcmp( a.key, b.key, n );
+    if (r != 0)
+        return r;
+
+    return (a.key_len > b.key_len) - (a.key_len < b.key_len);
+}
+
+void LineSorter::split_lines( const gchar *text, gsize len, std::vector<Line> &lines )
+{
+    lines.clear();
+
+    const gchar *p = text;
+    const gchar *end = text + len;
+    while (true)
+    {
+        const gchar *nl = (const gchar*)memchr( p, '\n', end - p );
+        const gchar *line_end = nl ? nl : end;
+
+        Line line;
+        line.data = p;
+        line.len = line_end - p;
+        line.key = p;
+        line.key_len = line.len;
+        line.has_number = false;
+        line.number = 0;
+        lines.push_back( line );
+
+        if (!nl)
+            break;
+        p = nl + 1;
+    }
+}
+
+void LineSorter::set_keys( gsize begin, gsize end )
+{
+    for (gsize i = begin; i < end; ++i)
+    {
+        Line &line = m_lines[i];
+
+        if (m_regex)
+        {
+            GMatchInfo *match_info;
+            if (g_regex_match_full( m_regex, line.data, line.len, 0,
+                                    (GRegexMatchFlags)0, &match_info, NULL ))
+            {
+                gint match_start, match_end;
+                g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+                if (m_flags & sort_on_match)
+                {
+                    line.key = line.data + match_start;
+                    line.key_len = match_end - match_start;
+                }
+                else
+                {
+                    line.key = line.data + match_end;
+                    line.key_len = line.len - match_end;
+                }
+            }
+            else
+            {
+                line.key = NULL;
+                line.key_len = 0;
+            }
+            g_match_info_free( match_info );
+        }
+
+        if ((m_flags & sort_numeric) && line.key)
+        {
+            const gchar *p = line.key;
+            const gchar *key_end = line.key + line.key_len;
+            while (p < key_end && !g_ascii_isdigit( *p ))
+                p++;
+
+            if (p < key_end)
+            {
+                bool negative = (p > line.key && p[-1] == '-');
+                //
+                //  Numbers too big for a gint64 (long IDs, say) sort as
+                //  the biggest (or smallest) one.
+                //
+                gint64 number = 0;
+                bool saturated = false;
+                for (; p < key_end && g_ascii_isdigit( *p ); ++p)
+                {
+                    int digit = *p - '0';
+                    if (number > (G_MAXINT64 - digit) / 10)
+                        saturated = true;
+                    else
+                        number = number * 10 + digit;
+                }
+
+                line.has_number = true;
+                if (saturated)
+                    line.number = negative ? G_MININT64 : G_MAXINT64;
+                else
+                    line.number = negative ? -number : number;
+            }
+        }
+    }
+}
+
+void LineSorter::sort_chunk( gsize begin, gsize end )
+{
+    set_keys( begin, end );
+    std::stable_sort( m_lines.begin() + begin, m_lines.begin() + end,
+                      Compare( m_flags ) );
+}
+
+void LineSorter::merge_runs( gsize begin, gsize middle, gsize end )
+{
+    //
+    //  std::merge takes from the first run when keys are equal, which
+    //  keeps the sort stable.
+    //
+    std::merge( m_lines.begin() + begin, m_lines.begin() + middle,
+                m_lines.begin() + middle, m_lines.begin() + end,
+                m_merged.begin() + begin, Compare( m_flags ) );
+    std::copy( m_merged.begin() + begin, m_merged.begin() + end,
+               m_lines.begin() + begin );
+}
+
+guint LineSorter::hash_line( gconstpointer p )
+{
+    const Line *line = static_cast<const Line*>( p );
+
+    guint hash = 5381;
+    for (gsize i = 0; i < line->len; ++i)
+        hash = hash * 33 + (guchar)line->data[i];
+    return hash;
+}
+
+gboolean LineSorter::equal_lines( gconstpointer a, gconstpointer b )
+{
+    const Line *line_a = static_cast<const Line*>( a );
+    const Line *line_b = static_cast<const Line*>( b );
+
+    return line_a->len == line_b->len &&
+           memcmp( line_a->data, line_b->data, line_a->len ) == 0;
+}
+
+guint LineSorter::get_n_threads()
+{
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+    return (guint)CLAMP( n, 1, 16 );
+}
@@ -0,0 +1,109 @@
+#ifndef SOURCERER_LINE_SORTER_H
+#define SOURCERER_LINE_SORTER_H
+
+#include <string>
+#include <vector>
+
+#include <gtkmm.h>
+
+/**
+ *  Sorts and removes duplicates from a block of lines, for :sort and
+ *  :uniq.
+ *
+ *  Lines are sorted as slices of the original text; nothing is copied
+ *  until the result is written out. Large blocks are split into one
+ *  chunk per processor, the chunks are sorted on worker threads, and
+ *  the sorted runs are merged in pairs, also in parallel. The sort is
+ *  stable.
+ */
+class LineSorter
+{
+    public:
+        enum Flags
+        {
+            sort_numeric = 0x01,        // by the first number in the key
+            sort_unique = 0x02,         // drop lines with equal keys
+            sort_on_match = 0x04,       // the key is the pattern match
+            sort_reverse = 0x08,
+            sort_ignore_case = 0x10
+        };
+
+        /**
+         *  Blocks with fewer lines than this are sorted on the calling
+         *  thread.
+         */
+        static const gsize PARALLEL_MIN = 64 * 1024;
+
+        LineSorter( int flags );
+        virtual ~LineSorter();
+
+        /**
+         *  Sorts on the text after the first match of pattern on each
+         *  line (or on the match itself, with sort_on_match). Lines
+         *  that don't match sort first, in their original order.
+         *  Returns false, and sets the error message, if the pattern
+         *  is invalid.
+         */
+        bool set_pattern( const std::string &pattern );
+
+        /**
+         *  Sorts the lines of text (len bytes, with no final newline)
+         *  and puts the result in out.
+         */
+        void sort( const gchar *text, gsize len, std::string &out );
+
+        /**
+         *  Removes all but the first of each set of equal lines,
+         *  keeping their order.
+         */
+        static void uniq( const gchar *text, gsize len, std::string &out );
+
+        const Glib::ustring& get_error() const { return m_error; }
+
+    protected:
+        struct Line
+        {
+            const gchar *data;
+            gsize len;
+            const gchar *key;       // NULL if the pattern didn't match
+            gsize key_len;
+            bool has_number;
+            gint64 number;
+        };
+
+        class Compare
+        {
+            public:
+                Compare( int flags ) : m_flags(flags) {}
+                bool operator()( const Line &a, const Line &b ) const;
+
+            protected:
+                int compare( const Line &a, const Line &b ) const;
+
+                int m_flags;
+        };
+
+        static void split_lines( const gchar *text, gsize len, std::vector<Line> &lines );
+
+        void set_keys( gsize begin, gsize end );
+        void sort_chunk( gsize begin, gsize end );
+        void merge_runs( gsize begin, gsize middle, gsize end );
+
+        static guint hash_line( gconstpointer line );
+        static gboolean equal_lines( gconstpointer a, gconstpointer b );
+
+        static guint get_n_threads();
+
+        int m_flags;
+        GRegex *m_regex;
+        Glib::ustring m_error;
+
+        std::vector<Line> m_lines;
+        std::vector<Line> m_merged;     // scratch space for merging
+
+    private:
+        LineSorter( const LineSorter& );
+        LineSorter& operator=( const LineSorter& );
+};
+
+#endif
@@ -54,6 +54,7 @@ MainWindow::MainWindow()
     m_editor_area.add_editor(&m_sourceEditor);
 
     m_info_area_bottom.append_page(m_repl, "REPL");
+    m_info_area_bottom.append_page(m_build, "Build");
 
     m_vpane.pack1(m_editor_area, true, true);
     m_vpane.pack2(m_info_area_bottom, false, true);
@@ -84,6 +85,11 @@ Gtk::Notebook* MainWindow::get_info_area(InfoArea which)
     }
 }
 
+BuildWindow* MainWindow::get_build_window()
+{
+    return &m_build;
+}
+
 EditorArea* MainWindow::get_editor_area() 
 {
     return &m_editor_area;
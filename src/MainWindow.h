@@ -3,6 +3,7 @@
 
 #include <gtkmm.h>
 
+#include "BuildWindow.h"
 #include "Editor.h"
 #include "EditorArea.h"
 #include "ReplWindow.h"
@@ -25,6 +26,8 @@ class MainWindow : public Gtk::Window
 
         Gtk::Notebook* get_info_area(InfoArea which);
 
+        BuildWindow* get_build_window();
+
         EditorArea* get_editor_area(); 
         Gtk::Statusbar* get_status_bar(); 
 
@@ -42,6 +45,7 @@ class MainWindow : public Gtk::Window
         Gtk::Statusbar m_statusBar;
 
         ReplWindow m_repl;
+        BuildWindow m_build;
 
         Gtk::VBox m_vbox;
         Gtk::VPaned m_vpane;
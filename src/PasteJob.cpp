@@ -0,0 +1,100 @@
+#include "PasteJob.h"
+
+#include "utils.h"
+
+void PasteJob::start( Glib::RefPtr<Gtk::TextBuffer> buffer,
+                      const Gtk::TextIter &where,
+                      Glib::RefPtr<ViRegisterValue> value )
+{
+    PasteJob *job = new PasteJob( buffer, where, value );
+
+    Glib::signal_idle().connect( sigc::mem_fun( *job, &PasteJob::on_idle ) );
+}
+
+PasteJob::PasteJob( Glib::RefPtr<Gtk::TextBuffer> buffer,
+                    const Gtk::TextIter &where,
+                    Glib::RefPtr<ViRegisterValue> value ) :
+    m_buffer(buffer),
+    m_value(value),
+    m_chunk_idx(0),
+    m_chunk_offset(0),
+    m_done(0),
+    m_last_percent(-1)
+{
+    m_value->get_chunks( m_chunks );
+
+    //
+    //  A right gravity mark stays after the text as it is inserted, 
+    //  and survives any other changes made to the buffer meanwhile.
+    //
+    m_mark = m_buffer->create_mark( where, false );
+
+    m_buffer->begin_user_action();
+    get_vi()->hold_input();
+    show_progress();
+}
+
+PasteJob::~PasteJob()
+{
+    m_buffer->end_user_action();
+    m_buffer->delete_mark( m_mark );
+
+    get_vi()->show_message( "" );
+    get_vi()->release_input();
+}
+
+bool PasteJob::on_idle()
+{
+    if (m_chunk_idx < m_chunks.size())
+    {
+        const gchar *data = m_chunks[m_chunk_idx]->get_data();
+        gsize length = m_chunks[m_chunk_idx]->get_length();
+
+        gsize begin = m_chunk_offset;
+        gsize end = begin + SLICE_SIZE;
+        if (end >= length)
+        {
+            end = length;
+        }
+        else
+        {
+            //
+            //  Don't split a UTF-8 sequence between two slices.
+            //
+            while (end > begin && (data[end] & 0xC0) == 0x80)
+                end--;
+        }
+
+        Gtk::TextIter iter = m_buffer->get_iter_at_mark( m_mark );
+        m_buffer->insert( iter, data + begin, data + end );
+
+        m_done += end - begin;
+        m_chunk_offset = end;
+        if (m_chunk_offset == length)
+        {
+            m_chunk_idx++;
+            m_chunk_offset = 0;
+        }
+
+        show_progress();
+    }
+
+    if (m_chunk_idx < m_chunks.size())
+    {
+        return true;
+    }
+
+    delete this;
+    return false;
+}
+
+void PasteJob::show_progress()
+{
+    int percent = (int)(m_done * 100 / m_value->get_length());
+
+    if (percent != m_last_percent)
+    {
+        get_vi()->show_message( "Pasting... %d%%", percent );
+        m_last_percent = percent;
+    }
+}
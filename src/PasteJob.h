@@ -0,0 +1,57 @@
+#ifndef SOURCERER_PASTE_JOB_H
+#define SOURCERER_PASTE_JOB_H
+
+#include <vector>
+
+#include <gtkmm.h>
+
+#include "ViRegister.h"
+
+/**
+ *  Inserts a large register value into a buffer a slice at a time
+ *  from idle callbacks, so the window keeps redrawing while the text
+ *  goes in. The whole paste is one user action (and so one undo step).
+ *  Key presses are held by the key manager until the paste finishes.
+ *
+ *  Jobs delete themselves when they are done.
+ */
+class PasteJob
+{
+    public:
+        /**
+         *  Registers at least this many bytes long are pasted in the
+         *  background. Smaller ones are inserted directly.
+         */
+        static const gsize THRESHOLD = 1024 * 1024;
+
+        /**
+         *  The most bytes inserted by a single idle callback.
+         */
+        static const gsize SLICE_SIZE = 256 * 1024;
+
+        static void start( Glib::RefPtr<Gtk::TextBuffer> buffer,
+                           const Gtk::TextIter &where,
+                           Glib::RefPtr<ViRegisterValue> value );
+
+    protected:
+        PasteJob( Glib::RefPtr<Gtk::TextBuffer> buffer,
+                  const Gtk::TextIter &where,
+                  Glib::RefPtr<ViRegisterValue> value );
+        ~PasteJob();
+
+        bool on_idle();
+        void show_progress();
+
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_mark;
+
+        Glib::RefPtr<ViRegisterValue> m_value;
+        std::vector< Glib::RefPtr<ViTextChunk> > m_chunks;
+        guint m_chunk_idx;
+        gsize m_chunk_offset;
+
+        gsize m_done;
+        int m_last_percent;
+};
+
+#endif
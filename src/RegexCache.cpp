@@ -0,0 +1,97 @@
+#include <cstdio>
+
+#include "RegexCache.h"
+
+RegexCache *RegexCache::self = 0;
+
+RegexCache* RegexCache::get()
+{
+    if (!self)
+        self = new RegexCache();
+    return self;
+}
+
+GRegex* RegexCache::compile( const std::string &pattern,
+                             int compile_flags,
+                             GError **error )
+{
+    compile_flags |= G_REGEX_OPTIMIZE;
+
+    Glib::Mutex::Lock lock( m_mutex );
+
+    std::list<Entry>::iterator it;
+    for (it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->compile_flags == compile_flags && it->pattern == pattern)
+        {
+            m_hits++;
+            m_entries.splice( m_entries.begin(), m_entries, it );
+            return g_regex_ref( it->regex );
+        }
+    }
+
+    m_misses++;
+
+    //
+    //  Compiling can take a while for a big pattern, so it is done
+    //  without the lock. Another thread may compile the same pattern
+    //  meanwhile; then both copies are cached for a while, harmlessly.
+    //
+    lock.release();
+
+    Glib::Timer timer;
+    GRegex *regex = g_regex_new( pattern.c_str(), (GRegexCompileFlags)compile_flags,
+                                 (GRegexMatchFlags)0, error );
+    timer.stop();
+
+    lock.acquire();
+    m_compile_time += timer.elapsed();
+
+    if (!regex)
+        return NULL;
+
+    Entry entry;
+    entry.pattern = pattern;
+    entry.compile_flags = compile_flags;
+    entry.regex = regex;
+    m_entries.push_front( entry );
+
+    if (m_entries.size() > CAPACITY)
+    {
+        g_regex_unref( m_entries.back().regex );
+        m_entries.pop_back();
+    }
+
+    return g_regex_ref( regex );
+}
+
+std::string RegexCache::get_report()
+{
+    Glib::Mutex::Lock lock( m_mutex );
+
+    guint lookups = m_hits + m_misses;
+    char report[256];
+    snprintf( report, sizeof(report),
+              "regex cache: %u/%u hits (%.0f%%), %u compiled in %.2f ms, %u/%u entries",
+              m_hits, lookups, lookups ? 100.0 * m_hits / lookups : 0.0,
+              m_misses, m_compile_time * 1000.0,
+              (guint)m_entries.size(), CAPACITY );
+    return report;
+}
+
+//
+// Protected
+//
+RegexCache::RegexCache() :
+    m_hits(0),
+    m_misses(0),
+    m_compile_time(0.0)
+{
+}
+
+RegexCache::~RegexCache()
+{
+    std::list<Entry>::iterator it;
+    for (it = m_entries.begin(); it != m_entries.end(); ++it)
+        g_regex_unref( it->regex );
+}
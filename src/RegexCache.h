@@ -0,0 +1,68 @@
+#ifndef SOURCERER_REGEX_CACHE_H
+#define SOURCERER_REGEX_CACHE_H
+
+#include <list>
+#include <string>
+
+#include <gtkmm.h>
+
+/**
+ *  The most recently used compiled patterns, shared by searching,
+ *  search highlighting, :s, :g and :sort, so repeating a pattern never
+ *  compiles it again.
+ *
+ *  Patterns are compiled with G_REGEX_OPTIMIZE, which lets GLib JIT
+ *  compile them where PCRE supports it. A GRegex can't be changed once
+ *  made, so one can be used from several threads; the cache itself is
+ *  locked, for the search worker.
+ */
+class RegexCache
+{
+    public:
+        /**
+         *  How many compiled patterns are kept.
+         */
+        static const guint CAPACITY = 32;
+
+        static RegexCache* get();
+
+        /**
+         *  Returns the compiled pattern, with a reference for the caller
+         *  to drop with g_regex_unref(). Returns NULL, and sets error,
+         *  if the pattern is invalid.
+         */
+        GRegex* compile( const std::string &pattern,
+                         int compile_flags,
+                         GError **error = NULL );
+
+        /**
+         *  A summary of how well the cache is doing, for :perf.
+         */
+        std::string get_report();
+
+    protected:
+        RegexCache();
+        virtual ~RegexCache();
+
+        struct Entry
+        {
+            std::string pattern;
+            int compile_flags;
+            GRegex *regex;
+        };
+
+        static RegexCache *self;
+
+        Glib::Mutex m_mutex;
+        std::list<Entry> m_entries;     // most recently used first
+
+        guint m_hits;
+        guint m_misses;
+        double m_compile_time;          // seconds
+
+    private:
+        RegexCache( const RegexCache& );
+        RegexCache& operator=( const RegexCache& );
+};
+
+#endif
@@ -3,12 +3,11 @@
 #include "App.h"
 #include "utils.h"
 
-#include "s7.h"
-
 const Glib::ustring PROMPT_MARK_NAME("Prompt");
 const Glib::ustring PROMPT("\nscheme>");
 
-ReplWindow::ReplWindow() : Gtk::VBox()
+ReplWindow::ReplWindow() : Gtk::VBox(),
+    m_pending(0)
 {
     m_scrollView.add(m_repl);
     m_scrollView.set_policy(Gtk::POLICY_AUTOMATIC, 
@@ -17,10 +16,16 @@ ReplWindow::ReplWindow() : Gtk::VBox()
     m_repl.set_buffer( m_buffer );
 
     pack_start(m_scrollView, true, true);
+    pack_start(m_gc_graph, false, false);
 
     m_repl.signal_key_press_event().connect( 
         sigc::mem_fun(*this, &ReplWindow::on_key ), false );
 
+    Application::get()->get_scheme()->signal_result().connect(
+        sigc::mem_fun(*this, &ReplWindow::on_result) );
+    Application::get()->get_scheme()->signal_gc().connect(
+        sigc::mem_fun(m_gc_graph, &GcGraph::add_records) );
+
 
     m_prompt_tag = Gtk::TextTag::create( "prompt" );
     m_prompt_tag->property_editable() = false;
@@ -43,49 +48,37 @@ void ReplWindow::append_text(Glib::ustring txt)
 
 void ReplWindow::evaluate(Glib::ustring &expression)
 {
-    Scheme *scm = Application::get()->get_scheme();
-    if (!expression.empty())
+    if (expression.empty())
     {
-        const char *errmsg;
-        s7_pointer old_port, result;                
-        int gc_loc = -1;
-
-        //
-        //  Open a port to catch error info
-        //
-        old_port = s7_set_current_error_port(scm, 
-                s7_open_output_string(scm));
-        if (old_port != s7_nil(scm))
-        {
-            gc_loc = s7_gc_protect(scm, old_port);
-        }
+        set_prompt();
+        return;
+    }
 
-        result = s7_eval_c_string(scm, expression.data());
+    //
+    //  The result comes back in on_result(); until then the REPL can't
+    //  be typed in.
+    //
+    append_text( "\n" );
+    m_repl.set_editable( false );
+    m_pending = Application::get()->get_scheme()->evaluate( expression.raw() );
+}
 
-        errmsg = s7_get_output_string(scm, s7_current_error_port(scm));
+void ReplWindow::cancel()
+{
+    if (m_pending)
+        Application::get()->get_scheme()->cancel();
+}
 
-        append_text( "\n" );
+void ReplWindow::on_result(guint id, const std::string &text, bool error)
+{
+    if (id != m_pending)
+        return;
 
-        if ((errmsg) && (*errmsg))
-        {
-            append_text(errmsg);
-        }
-        else
-        {
-            char *result_as_string;
-            result_as_string = s7_object_to_c_string(scm, result);
-            if (result_as_string)
-            {
-                append_text(result_as_string);        
-                free(result_as_string);
-            }
-        }
+    append_text( text );
 
-        s7_close_output_port(scm, s7_current_error_port(scm));
-        s7_set_current_error_port(scm, old_port);
-        if (gc_loc != -1)
-            s7_gc_unprotect_at(scm, gc_loc);
-    }
+    m_pending = 0;
+    m_repl.set_editable( true );
+    set_prompt();
 }
 
 bool
@@ -94,13 +87,21 @@ ReplWindow::on_key(GdkEventKey *e)
 
     g_print("ReplWindow key press\n");
 
-    if (e->keyval == GDK_Return)
+    if (e->keyval == GDK_c && (e->state & GDK_CONTROL_MASK))
     {
-        Glib::ustring exp = get_current_expression(); 
-        evaluate(exp);
+        cancel();
+        return true;
+    }
 
-        g_print("expression: %s\n", exp.data());
-        set_prompt();
+    if (e->keyval == GDK_Return)
+    {
+        if (!m_pending)
+        {
+            Glib::ustring exp = get_current_expression(); 
+            g_print("expression: %s\n", exp.data());
+            evaluate(exp);
+        }
+        return true;
     }
 
     return false;
@@ -118,7 +119,7 @@ ReplWindow::get_current_expression()
 void
 ReplWindow::set_prompt()
 {
-    ViTextIter iter = get_cursor_iter( m_buffer );
+    Gtk::TextIter iter = m_buffer->end();
 
     m_buffer->insert_with_tag( iter, PROMPT, "prompt" );
     iter = m_buffer->end();
@@ -3,16 +3,23 @@
 
 #include <gtkmm.h>
 
+#include "GcGraph.h"
+
 class ReplWindow : public Gtk::VBox
 {
     public:
         ReplWindow();
         virtual ~ReplWindow();
 
+        /**
+         *  Interrupts the expression being evaluated, if any.
+         */
+        void cancel();
 
     protected:
         void append_text(Glib::ustring txt);
         void evaluate(Glib::ustring &expression);
+        void on_result(guint id, const std::string &text, bool error);
 
         virtual bool on_key(GdkEventKey *e);
 
@@ -24,6 +31,9 @@ class ReplWindow : public Gtk::VBox
         Glib::RefPtr<Gtk::TextTag> m_prompt_tag;
 
         Gtk::ScrolledWindow m_scrollView;
+        GcGraph m_gc_graph;
+
+        guint m_pending;        // the expression being evaluated, or 0
 
 };
 
@@ -0,0 +1,314 @@
+#include <cstdlib>
+
+#include "App.h"
+#include "SchemeWorker.h"
+#include "utils.h"
+
+SchemeWorker *SchemeWorker::s_self = 0;
+
+SchemeWorker::SchemeWorker() :
+    m_scm(NULL),
+    m_hook_calls(0),
+    m_last_gc(0),
+    m_thread(NULL),
+    m_last_id(0),
+    m_quit(false),
+    m_cancelled(0)
+{
+    s_self = this;
+
+    m_dispatcher.connect( sigc::mem_fun( *this, &SchemeWorker::on_dispatch ) );
+    m_thread = Glib::Thread::create(
+            sigc::mem_fun( *this, &SchemeWorker::run ), true );
+}
+
+SchemeWorker::~SchemeWorker()
+{
+    {
+        Glib::Mutex::Lock lock( m_mutex );
+        m_quit = true;
+        m_requests.clear();
+        g_atomic_int_set( &m_cancelled, 1 );
+        m_cond.signal();
+    }
+    m_thread->join();
+
+    s_self = 0;
+}
+
+guint SchemeWorker::evaluate( const std::string &expression )
+{
+    Glib::Mutex::Lock lock( m_mutex );
+
+    Request req;
+    req.id = ++m_last_id;
+    req.expression = expression;
+    m_requests.push_back( req );
+    m_cond.signal();
+
+    return req.id;
+}
+
+void SchemeWorker::cancel()
+{
+    Glib::Mutex::Lock lock( m_mutex );
+
+    while (!m_requests.empty())
+    {
+        Response resp;
+        resp.id = m_requests.front().id;
+        resp.text = "Interrupted";
+        resp.error = true;
+        m_responses.push_back( resp );
+        m_requests.pop_front();
+    }
+    m_dispatcher.emit();
+
+    g_atomic_int_set( &m_cancelled, 1 );
+}
+
+//
+// Protected
+//
+void SchemeWorker::run()
+{
+    m_scm = s7_init();
+    s7_set_begin_hook( m_scm, begin_hook );
+
+    s7_define_function( m_scm, "editor-insert", g_editor_insert, 1, 0, false,
+                        "(editor-insert str) inserts str at the cursor of the current editor" );
+    s7_define_function( m_scm, "editor-goto-line", g_editor_goto_line, 1, 0, false,
+                        "(editor-goto-line n) moves the cursor of the current editor to line n" );
+    s7_define_function( m_scm, "editor-message", g_editor_message, 1, 0, false,
+                        "(editor-message str) shows str in the status bar" );
+
+    Glib::Mutex::Lock lock( m_mutex );
+    while (true)
+    {
+        while (m_requests.empty() && !m_quit)
+            m_cond.wait( m_mutex );
+
+        if (m_quit)
+            break;
+
+        Request req = m_requests.front();
+        m_requests.pop_front();
+        g_atomic_int_set( &m_cancelled, 0 );
+
+        lock.release();
+
+        Response resp;
+        m_flush_timer.start();
+        eval( req, resp );
+        flush_calls( &resp );
+
+        lock.acquire();
+    }
+}
+
+void SchemeWorker::eval( const Request &req, Response &resp )
+{
+    resp.id = req.id;
+    resp.error = false;
+
+    //
+    //  Open a port to catch error info
+    //
+    s7_pointer old_port = s7_set_current_error_port( m_scm,
+            s7_open_output_string( m_scm ) );
+    int gc_loc = -1;
+    if (old_port != s7_nil( m_scm ))
+        gc_loc = s7_gc_protect( m_scm, old_port );
+
+    s7_pointer result = s7_eval_c_string( m_scm, req.expression.c_str() );
+
+    const char *errmsg = s7_get_output_string( m_scm, s7_current_error_port( m_scm ) );
+
+    if (g_atomic_int_get( &m_cancelled ))
+    {
+        resp.text = "Interrupted";
+        resp.error = true;
+    }
+    else if (errmsg && *errmsg)
+    {
+        resp.text = errmsg;
+        resp.error = true;
+    }
+    else
+    {
+        char *result_as_string = s7_object_to_c_string( m_scm, result );
+        if (result_as_string)
+        {
+            resp.text = result_as_string;
+            free( result_as_string );
+        }
+    }
+
+    s7_close_output_port( m_scm, s7_current_error_port( m_scm ) );
+    s7_set_current_error_port( m_scm, old_port );
+    if (gc_loc != -1)
+        s7_gc_unprotect_at( m_scm, gc_loc );
+}
+
+void SchemeWorker::queue_call( EditorCallType type, const std::string &text, int line )
+{
+    EditorCall call;
+    call.type = type;
+    call.text = text;
+    call.line = line;
+    m_calls.push_back( call );
+
+    if (m_calls.size() >= BATCH_SIZE)
+        flush_calls( NULL );
+}
+
+//
+//  Sends the queued editor calls, and resp if there is one, to the
+//  main loop. The calls are applied before the result is reported.
+//
+void SchemeWorker::flush_calls( Response *resp )
+{
+    s7_gc_record records[GC_RECORDS];
+    int n = s7_gc_history( m_scm, records, GC_RECORDS );
+    int first = 0;
+    while (first < n && records[first].number <= m_last_gc)
+        ++first;
+    if (n > 0)
+        m_last_gc = records[n - 1].number;
+
+    {
+        Glib::Mutex::Lock lock( m_mutex );
+        m_sent_calls.insert( m_sent_calls.end(), m_calls.begin(), m_calls.end() );
+        m_gc_records.insert( m_gc_records.end(), records + first, records + n );
+        if (resp)
+            m_responses.push_back( *resp );
+    }
+    m_calls.clear();
+    m_flush_timer.start();
+
+    m_dispatcher.emit();
+}
+
+bool SchemeWorker::has_new_collections()
+{
+    s7_gc_record last;
+    return s7_gc_history( m_scm, &last, 1 ) == 1 && last.number > m_last_gc;
+}
+
+void SchemeWorker::on_dispatch()
+{
+    std::vector<EditorCall> calls;
+    std::vector<Response> responses;
+    std::vector<s7_gc_record> gc_records;
+    {
+        Glib::Mutex::Lock lock( m_mutex );
+        calls.swap( m_sent_calls );
+        responses.swap( m_responses );
+        gc_records.swap( m_gc_records );
+    }
+
+    if (!calls.empty())
+        apply_calls( calls );
+
+    if (!gc_records.empty())
+        m_signal_gc.emit( gc_records );
+
+    for (guint i = 0; i < responses.size(); ++i)
+        m_signal_result.emit( responses[i].id, responses[i].text, responses[i].error );
+}
+
+void SchemeWorker::apply_calls( const std::vector<EditorCall> &calls )
+{
+    SourceEditor *ed = dynamic_cast<SourceEditor*>( Application::get()->get_current_editor() );
+    if (!ed)
+        return;
+
+    Gtk::TextView &view = ed->get_view();
+    Glib::RefPtr<Gtk::TextBuffer> buffer = view.get_buffer();
+
+    buffer->begin_user_action();
+
+    std::string text;
+    for (guint i = 0; i < calls.size(); ++i)
+    {
+        const EditorCall &call = calls[i];
+
+        //
+        //  Runs of inserts go in as one.
+        //
+        if (call.type == call_insert)
+        {
+            text += call.text;
+            if (i + 1 < calls.size() && calls[i + 1].type == call_insert)
+                continue;
+
+            buffer->insert_at_cursor( text );
+            text.clear();
+        }
+        else if (call.type == call_goto_line)
+        {
+            set_cursor_at_line( buffer, CLAMP( call.line, 1, get_last_line( buffer ) ), false );
+        }
+        else if (call.type == call_message)
+        {
+            get_vi()->show_message( "%s", call.text.c_str() );
+        }
+    }
+
+    buffer->end_user_action();
+
+    view.scroll_to( buffer->get_insert() );
+}
+
+//
+//  Called by s7 at the start of every block, on the worker thread.
+//  Returning true stops the evaluation.
+//
+//  This runs many millions of times a second in a tight loop, so the
+//  clock is only read every FLUSH_CHECK_INTERVAL calls.
+//
+bool SchemeWorker::begin_hook( s7_scheme *sc )
+{
+    if (g_atomic_int_get( &s_self->m_cancelled ))
+        return true;
+
+    if (++s_self->m_hook_calls < FLUSH_CHECK_INTERVAL)
+        return false;
+    s_self->m_hook_calls = 0;
+
+    if (s_self->m_flush_timer.elapsed() * 1000 >= FLUSH_INTERVAL &&
+        (!s_self->m_calls.empty() || s_self->has_new_collections()))
+        s_self->flush_calls( NULL );
+
+    return false;
+}
+
+s7_pointer SchemeWorker::g_editor_insert( s7_scheme *sc, s7_pointer args )
+{
+    s7_pointer str = s7_car( args );
+    if (!s7_is_string( str ))
+        return s7_wrong_type_arg_error( sc, "editor-insert", 0, str, "a string" );
+
+    s_self->queue_call( call_insert, s7_string( str ), 0 );
+    return str;
+}
+
+s7_pointer SchemeWorker::g_editor_goto_line( s7_scheme *sc, s7_pointer args )
+{
+    s7_pointer line = s7_car( args );
+    if (!s7_is_integer( line ))
+        return s7_wrong_type_arg_error( sc, "editor-goto-line", 0, line, "an integer" );
+
+    s_self->queue_call( call_goto_line, "", (int)s7_integer( line ) );
+    return line;
+}
+
+s7_pointer SchemeWorker::g_editor_message( s7_scheme *sc, s7_pointer args )
+{
+    s7_pointer str = s7_car( args );
+    if (!s7_is_string( str ))
+        return s7_wrong_type_arg_error( sc, "editor-message", 0, str, "a string" );
+
+    s_self->queue_call( call_message, s7_string( str ), 0 );
+    return str;
+}
@@ -0,0 +1,161 @@
+#ifndef SOURCERER_SCHEME_WORKER_H
+#define SOURCERER_SCHEME_WORKER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <gtkmm.h>
+
+#include "s7.h"
+
+/**
+ *  Owns the Scheme interpreter and runs it on a thread of its own, so
+ *  a long evaluation never holds up the editor.
+ *
+ *  Expressions are queued with evaluate() and their results come back
+ *  on the main loop through signal_result(), in order. cancel() stops
+ *  the evaluation being run (s7 checks for it at the start of every
+ *  block) and drops those waiting.
+ *
+ *  The interpreter can't touch GTK from its thread, so the editor
+ *  primitives it provides -- editor-insert, editor-goto-line and
+ *  editor-message -- only queue what they would do. The queue is sent
+ *  to the main loop in batches: when it is full, every FLUSH_INTERVAL
+ *  milliseconds during a long evaluation, and when the evaluation
+ *  ends. Each batch is applied as one user action. The interpreter's
+ *  garbage collection records go along with them, for the REPL.
+ */
+class SchemeWorker
+{
+    public:
+        /**
+         *  The most editor calls sent in one batch.
+         */
+        static const guint BATCH_SIZE = 256;
+
+        /**
+         *  How often, in milliseconds, editor calls are sent while an
+         *  evaluation is running.
+         */
+        static const guint FLUSH_INTERVAL = 50;
+
+        /**
+         *  The most garbage collection records sent in one batch.
+         */
+        static const int GC_RECORDS = 64;
+
+        /**
+         *  How many blocks s7 starts between looks at the flush timer.
+         *  Cancelling is checked at every one.
+         */
+        static const guint FLUSH_CHECK_INTERVAL = 4096;
+
+        SchemeWorker();
+        virtual ~SchemeWorker();
+
+        /**
+         *  Queues expression for evaluation. Returns the id its result
+         *  will carry.
+         */
+        guint evaluate( const std::string &expression );
+
+        /**
+         *  Interrupts the evaluation being run and drops those queued.
+         *  Each of them reports "Interrupted".
+         */
+        void cancel();
+
+        /**
+         *  The id, the result (or error message), and whether it is an
+         *  error.
+         */
+        sigc::signal<void, guint, const std::string&, bool>& signal_result()
+        {
+            return m_signal_result;
+        }
+
+        /**
+         *  The interpreter's garbage collections since the last time,
+         *  oldest first. Sent along with the editor calls.
+         */
+        sigc::signal<void, const std::vector<s7_gc_record>&>& signal_gc()
+        {
+            return m_signal_gc;
+        }
+
+    protected:
+        enum EditorCallType
+        {
+            call_insert,
+            call_goto_line,
+            call_message
+        };
+
+        struct EditorCall
+        {
+            EditorCallType type;
+            std::string text;
+            int line;
+        };
+
+        struct Request
+        {
+            guint id;
+            std::string expression;
+        };
+
+        struct Response
+        {
+            guint id;
+            std::string text;
+            bool error;
+        };
+
+        void run();
+        void eval( const Request &req, Response &resp );
+        void queue_call( EditorCallType type, const std::string &text, int line );
+        void flush_calls( Response *resp );
+        bool has_new_collections();
+
+        void on_dispatch();
+        void apply_calls( const std::vector<EditorCall> &calls );
+
+        static bool begin_hook( s7_scheme *sc );
+        static s7_pointer g_editor_insert( s7_scheme *sc, s7_pointer args );
+        static s7_pointer g_editor_goto_line( s7_scheme *sc, s7_pointer args );
+        static s7_pointer g_editor_message( s7_scheme *sc, s7_pointer args );
+
+        //
+        //  The worker the primitives belong to; there is one
+        //  interpreter.
+        //
+        static SchemeWorker *s_self;
+
+        s7_scheme *m_scm;                   // only used by the thread
+        std::vector<EditorCall> m_calls;    // queued by the thread
+        Glib::Timer m_flush_timer;
+        guint m_hook_calls;                 // since the timer was last read
+        guint m_last_gc;                    // the last collection sent
+
+        Glib::Thread *m_thread;
+        Glib::Mutex m_mutex;
+        Glib::Cond m_cond;
+        std::deque<Request> m_requests;
+        std::vector<EditorCall> m_sent_calls;
+        std::vector<Response> m_responses;
+        std::vector<s7_gc_record> m_gc_records;
+        guint m_last_id;
+        bool m_quit;
+        volatile gint m_cancelled;
+
+        Glib::Dispatcher m_dispatcher;
+        sigc::signal<void, guint, const std::string&, bool> m_signal_result;
+        sigc::signal<void, const std::vector<s7_gc_record>&> m_signal_gc;
+
+    private:
+        SchemeWorker( const SchemeWorker& );
+        SchemeWorker& operator=( const SchemeWorker& );
+};
+
+#endif
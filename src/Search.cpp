@@ -1,4 +1,5 @@
 
+#include "RegexCache.h"
 #include "Search.h"
 #include "ViTextIter.h"
 
@@ -9,7 +10,7 @@ SearchSupport::SearchSupport()
 
 SearchSupport::~SearchSupport()
 {
-    m_matches.clear();
+    clear_matches();
 }
 
 void SearchSupport::set_buffer( Glib::RefPtr<Gtk::TextBuffer> buffer )
@@ -72,47 +73,47 @@ bool SearchSupport::search( const Glib::ustring &pattern,
 bool
 SearchSupport::find_all( const Glib::ustring &pattern )
 {
-    m_matches.clear();
-
-    Glib::ustring text = m_buffer->get_text();
+    clear_matches();
 
-    GRegex *regex;
-    GMatchInfo *match_info;
-    GRegexCompileFlags compile_flags;
-    GRegexMatchFlags match_options;
     GError *error = NULL;
-
-    regex = g_regex_new( pattern.data(), 
-                         compile_flags, 
-                         match_options, &error );
+    GRegex *regex = RegexCache::get()->compile( pattern.raw(), G_REGEX_MULTILINE, &error );
 
     if ( error )
     {
         g_print("Error while creating regex: %s\n", error->message);
+        g_error_free( error );
         return false;
     }
 
-    
-    if (!g_regex_match( regex, text.data(), 
-                        match_options, &match_info ))
+    Glib::ustring text = m_buffer->get_text();
+
+    GMatchInfo *match_info;
+    if (!g_regex_match( regex, text.data(), (GRegexMatchFlags)0, &match_info ))
     {
+        g_match_info_free( match_info );
+        g_regex_unref( regex );
         return false;
     }
 
+    //
+    //  Matches are found at byte positions; the cursor works in
+    //  characters, so count them along from one match to the next.
+    //
     gint start, end;
+    const gchar *counted = text.data();
+    int offset = 0;
 
-    int idx=0;
     while (g_match_info_matches(match_info))
     {
-        if (!g_match_info_fetch_pos( match_info, 0, &start, &end ))
-        {
-            m_matches.clear();
-            return false;
-        }
+        g_match_info_fetch_pos( match_info, 0, &start, &end );
+
+        offset += g_utf8_pointer_to_offset( counted, text.data() + start );
+        counted = text.data() + start;
 
         MatchInfo *info = new MatchInfo();
-        info->start_pos = start;
-        info->end_pos = end;
+        info->start_pos = offset;
+        info->end_pos = offset + g_utf8_pointer_to_offset( text.data() + start,
+                                                           text.data() + end );
         m_matches.push_back( info );
 
         g_match_info_next( match_info, NULL ); 
@@ -123,3 +124,11 @@ SearchSupport::find_all( const Glib::ustring &pattern )
 
     return true;
 }
+
+void SearchSupport::clear_matches()
+{
+    std::list< MatchInfo* >::iterator it;
+    for ( it = m_matches.begin(); it != m_matches.end(); it++)
+        delete *it;
+    m_matches.clear();
+}
@@ -40,6 +40,8 @@ class SearchSupport
          */
         bool find_all( const Glib::ustring &pattern );
 
+        void clear_matches();
+
 
         /**
          * A reference to the TextBuffer
@@ -0,0 +1,250 @@
+#include <cstring>
+
+#include "SearchHighlighter.h"
+#include "RegexCache.h"
+#include "utils.h"
+
+std::string SearchHighlighter::s_pattern;
+bool SearchHighlighter::s_hidden = false;
+
+SearchHighlighter::SearchHighlighter( Gtk::TextView &view ) :
+    m_view(view),
+    m_tagged(false),
+    m_dirty(false),
+    m_regex(NULL)
+{
+    m_view.signal_size_allocate().connect(
+        sigc::mem_fun( *this, &SearchHighlighter::on_size_allocate ) );
+    m_view.signal_map().connect(
+        sigc::mem_fun( *this, &SearchHighlighter::queue_update ) );
+
+    m_pattern_changed = signal_pattern_changed().connect(
+        sigc::mem_fun( *this, &SearchHighlighter::on_changed ) );
+    m_counter.signal_done().connect(
+        sigc::mem_fun( *this, &SearchHighlighter::on_count_done ) );
+}
+
+SearchHighlighter::~SearchHighlighter()
+{
+    m_idle.disconnect();
+    m_scroll.disconnect();
+    m_changed.disconnect();
+    m_pattern_changed.disconnect();
+
+    if (m_regex)
+        g_regex_unref( m_regex );
+}
+
+void SearchHighlighter::set_buffer( Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    m_changed.disconnect();
+    m_scroll.disconnect();
+
+    m_buffer = buffer;
+    m_tag = m_buffer->create_tag();
+    m_tag->property_background() = "#ffff66";
+    m_start = m_buffer->create_mark( m_buffer->begin(), true );
+    m_end = m_buffer->create_mark( m_buffer->begin(), false );
+    m_tagged = false;
+
+    m_changed = m_buffer->signal_changed().connect(
+        sigc::mem_fun( *this, &SearchHighlighter::on_changed ) );
+
+    Gtk::Adjustment *adj = m_view.get_vadjustment();
+    if (adj)
+    {
+        m_scroll = adj->signal_value_changed().connect(
+            sigc::mem_fun( *this, &SearchHighlighter::queue_update ) );
+    }
+
+    queue_update();
+}
+
+void SearchHighlighter::count_matches()
+{
+    if (!m_buffer || s_pattern.empty())
+        return;
+
+    int origin = m_buffer->get_iter_at_mark( m_buffer->get_insert() ).get_offset();
+    m_counter.post( SearchWorker::count_all, m_buffer, s_pattern, origin );
+}
+
+void SearchHighlighter::set_pattern( const Glib::ustring &pattern )
+{
+    s_pattern = pattern.raw();
+    s_hidden = false;
+    signal_pattern_changed().emit();
+}
+
+void SearchHighlighter::hide()
+{
+    s_hidden = true;
+    signal_pattern_changed().emit();
+}
+
+//
+// Protected
+//
+void SearchHighlighter::queue_update()
+{
+    //
+    //  After the view has been laid out (GTK_PRIORITY_RESIZE) but before
+    //  it is drawn (GDK_PRIORITY_REDRAW).
+    //
+    if (!m_idle.connected())
+    {
+        m_idle = Glib::signal_idle().connect(
+            sigc::mem_fun( *this, &SearchHighlighter::on_idle ),
+            Glib::PRIORITY_HIGH_IDLE + 15 );
+    }
+}
+
+bool SearchHighlighter::on_idle()
+{
+    update();
+    return false;
+}
+
+void SearchHighlighter::on_changed()
+{
+    m_dirty = true;
+    queue_update();
+}
+
+void SearchHighlighter::on_size_allocate( Gtk::Allocation &allocation )
+{
+    queue_update();
+}
+
+void SearchHighlighter::on_count_done( const SearchWorker::Result &result )
+{
+    if (result.count == 0)
+        return;
+
+    if (result.index == 0)
+        get_vi()->show_message( "/%s  %d matches", s_pattern.c_str(), result.count );
+    else
+        get_vi()->show_message( "/%s  match %d of %d", s_pattern.c_str(),
+                                result.index, result.count );
+}
+
+void SearchHighlighter::update()
+{
+    if (!m_buffer)
+        return;
+
+    if (s_hidden || s_pattern.empty() || !m_view.is_mapped())
+    {
+        clear();
+        return;
+    }
+
+    if (m_regex_pattern != s_pattern)
+    {
+        if (m_regex)
+            g_regex_unref( m_regex );
+
+        m_regex_pattern = s_pattern;
+        m_regex = RegexCache::get()->compile( s_pattern, G_REGEX_MULTILINE );
+        m_dirty = true;
+    }
+
+    if (!m_regex)
+    {
+        clear();
+        return;
+    }
+
+    Gdk::Rectangle rect;
+    m_view.get_visible_rect( rect );
+
+    Gtk::TextIter top, bottom;
+    int y;
+    m_view.get_line_at_y( top, rect.get_y(), y );
+    m_view.get_line_at_y( bottom, rect.get_y() + rect.get_height(), y );
+
+    //
+    //  Nothing to do while the lines on screen are still within those
+    //  tagged.
+    //
+    if (m_tagged && !m_dirty)
+    {
+        Gtk::TextIter tagged_start = m_buffer->get_iter_at_mark( m_start );
+        Gtk::TextIter tagged_end = m_buffer->get_iter_at_mark( m_end );
+        if (top.get_line() >= tagged_start.get_line() &&
+            (bottom.get_line() < tagged_end.get_line() || tagged_end.is_end()))
+            return;
+    }
+
+    clear();
+
+    int first = top.get_line() - MARGIN_LINES;
+    if (first < 0)
+        first = 0;
+    int last = bottom.get_line() + MARGIN_LINES;
+
+    Gtk::TextIter start = m_buffer->get_iter_at_line( first );
+    Gtk::TextIter end = (last + 1 < m_buffer->get_line_count())
+                            ? m_buffer->get_iter_at_line( last + 1 )
+                            : m_buffer->end();
+
+    m_buffer->move_mark( m_start, start );
+    m_buffer->move_mark( m_end, end );
+    m_tagged = true;
+    m_dirty = false;
+
+    int base = start.get_offset();
+    gchar *text = gtk_text_buffer_get_text( m_buffer->gobj(), start.gobj(),
+                                            end.gobj(), TRUE );
+    gsize len = strlen( text );
+
+    //
+    //  Applying a tag invalidates iterators, so each match is looked up
+    //  by its offset, counted along from the last one.
+    //
+    const gchar *counted = text;
+    int offset = base;
+
+    GMatchInfo *match_info;
+    g_regex_match_full( m_regex, text, len, 0, (GRegexMatchFlags)0, &match_info, NULL );
+    while (g_match_info_matches( match_info ))
+    {
+        gint match_start, match_end;
+        g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+
+        if (match_end > match_start)
+        {
+            offset += g_utf8_pointer_to_offset( counted, text + match_start );
+            counted = text + match_start;
+
+            int n_chars = g_utf8_pointer_to_offset( text + match_start, text + match_end );
+            m_buffer->apply_tag( m_tag, m_buffer->get_iter_at_offset( offset ),
+                                 m_buffer->get_iter_at_offset( offset + n_chars ) );
+        }
+
+        g_match_info_next( match_info, NULL );
+    }
+    g_match_info_free( match_info );
+    g_free( text );
+
+    //
+    //  Stay above the syntax highlighting, whose tags are added later.
+    //
+    m_tag->set_priority( m_buffer->get_tag_table()->get_size() - 1 );
+}
+
+void SearchHighlighter::clear()
+{
+    if (!m_tagged)
+        return;
+
+    m_buffer->remove_tag( m_tag, m_buffer->get_iter_at_mark( m_start ),
+                          m_buffer->get_iter_at_mark( m_end ) );
+    m_tagged = false;
+}
+
+sigc::signal<void>& SearchHighlighter::signal_pattern_changed()
+{
+    static sigc::signal<void> signal;
+    return signal;
+}
@@ -0,0 +1,90 @@
+#ifndef SOURCERER_SEARCH_HIGHLIGHTER_H
+#define SOURCERER_SEARCH_HIGHLIGHTER_H
+
+#include <string>
+
+#include <gtkmm.h>
+
+#include "SearchWorker.h"
+
+/**
+ *  Highlights the matches of the last search in a text view.
+ *
+ *  Only the lines on screen, plus a margin above and below, are ever
+ *  tagged, so the cost doesn't depend on how many matches there are in
+ *  the whole buffer. The region is re-scanned from an idle handler
+ *  after the view scrolls out of it, is resized, or its text changes.
+ *
+ *  The total number of matches, and which of them the cursor is on,
+ *  is counted on a worker thread after each search and shown in the
+ *  status bar.
+ */
+class SearchHighlighter
+{
+    public:
+        /**
+         *  The lines tagged above and below those on screen.
+         */
+        static const int MARGIN_LINES = 100;
+
+        SearchHighlighter( Gtk::TextView &view );
+        virtual ~SearchHighlighter();
+
+        void set_buffer( Glib::RefPtr<Gtk::TextBuffer> buffer );
+
+        /**
+         *  Counts the matches in the background, then shows
+         *  "match N of M" for the one at the cursor.
+         */
+        void count_matches();
+
+        /**
+         *  Sets the pattern highlighted in every view, and shows the
+         *  highlighting again if it was hidden.
+         */
+        static void set_pattern( const Glib::ustring &pattern );
+
+        /**
+         *  Hides the highlighting until the next search (:nohlsearch).
+         */
+        static void hide();
+
+    protected:
+        void queue_update();
+        bool on_idle();
+        void on_changed();
+        void on_size_allocate( Gtk::Allocation &allocation );
+        void on_count_done( const SearchWorker::Result &result );
+
+        void update();
+        void clear();
+
+        static sigc::signal<void>& signal_pattern_changed();
+
+        static std::string s_pattern;
+        static bool s_hidden;
+
+        Gtk::TextView &m_view;
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        Glib::RefPtr<Gtk::TextTag> m_tag;
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_start;    // of the tagged lines
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_end;
+        bool m_tagged;
+        bool m_dirty;           // the tagged lines have changed
+
+        GRegex *m_regex;
+        std::string m_regex_pattern;
+
+        SearchWorker m_counter;
+
+        sigc::connection m_idle;
+        sigc::connection m_scroll;
+        sigc::connection m_changed;
+        sigc::connection m_pattern_changed;
+
+    private:
+        SearchHighlighter( const SearchHighlighter& );
+        SearchHighlighter& operator=( const SearchHighlighter& );
+};
+
+#endif
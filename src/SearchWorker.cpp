@@ -0,0 +1,412 @@
+#include <cstring>
+
+#include "SearchWorker.h"
+#include "RegexCache.h"
+
+SearchWorker::SearchWorker() :
+    m_snapshot(NULL),
+    m_thread(NULL),
+    m_pending(false),
+    m_last_id(0),
+    m_quit(false),
+    m_cancelled(0)
+{
+    m_request.snapshot = NULL;
+    m_result.id = 0;
+
+    m_dispatcher.connect( sigc::mem_fun( *this, &SearchWorker::on_dispatch ) );
+}
+
+SearchWorker::~SearchWorker()
+{
+    if (m_thread)
+    {
+        {
+            Glib::Mutex::Lock lock( m_mutex );
+            m_quit = true;
+            g_atomic_int_set( &m_cancelled, 1 );
+            m_cond.signal();
+        }
+        m_thread->join();
+    }
+
+    if (m_pending)
+        snapshot_unref( m_request.snapshot );
+    on_buffer_changed();
+}
+
+guint SearchWorker::post( Kind kind,
+                          Glib::RefPtr<Gtk::TextBuffer> buffer,
+                          const std::string &pattern,
+                          int origin )
+{
+    if (!m_snapshot || m_buffer != buffer)
+    {
+        on_buffer_changed();
+
+        Gtk::TextIter start = buffer->begin();
+        Gtk::TextIter end = buffer->end();
+
+        m_snapshot = new Snapshot;
+        m_snapshot->ref = 1;
+        m_snapshot->text = gtk_text_buffer_get_text( buffer->gobj(), start.gobj(),
+                                                     end.gobj(), TRUE );
+        m_snapshot->len = strlen( m_snapshot->text );
+
+        m_buffer = buffer;
+        m_changed = buffer->signal_changed().connect(
+                    sigc::mem_fun( *this, &SearchWorker::on_buffer_changed ) );
+    }
+
+    Glib::Mutex::Lock lock( m_mutex );
+
+    if (m_pending)
+        snapshot_unref( m_request.snapshot );
+
+    m_request.id = ++m_last_id;
+    m_request.kind = kind;
+    m_request.pattern = pattern;
+    m_request.origin = origin;
+    m_request.snapshot = snapshot_ref( m_snapshot );
+    m_pending = true;
+
+    //
+    //  Stop the one being run, if any.
+    //
+    g_atomic_int_set( &m_cancelled, 1 );
+
+    if (!m_thread)
+    {
+        m_thread = Glib::Thread::create(
+                sigc::mem_fun( *this, &SearchWorker::run ), true );
+    }
+    m_cond.signal();
+
+    return m_request.id;
+}
+
+void SearchWorker::cancel()
+{
+    Glib::Mutex::Lock lock( m_mutex );
+
+    if (m_pending)
+    {
+        snapshot_unref( m_request.snapshot );
+        m_pending = false;
+    }
+    ++m_last_id;
+    g_atomic_int_set( &m_cancelled, 1 );
+}
+
+//
+// Protected
+//
+SearchWorker::Snapshot* SearchWorker::snapshot_ref( Snapshot *snapshot )
+{
+    g_atomic_int_inc( &snapshot->ref );
+    return snapshot;
+}
+
+void SearchWorker::snapshot_unref( Snapshot *snapshot )
+{
+    if (g_atomic_int_dec_and_test( &snapshot->ref ))
+    {
+        g_free( snapshot->text );
+        delete snapshot;
+    }
+}
+
+void SearchWorker::on_buffer_changed()
+{
+    m_changed.disconnect();
+    m_buffer.clear();
+
+    if (m_snapshot)
+    {
+        snapshot_unref( m_snapshot );
+        m_snapshot = NULL;
+    }
+}
+
+void SearchWorker::on_dispatch()
+{
+    Result result;
+    {
+        Glib::Mutex::Lock lock( m_mutex );
+        if (m_result.id != m_last_id)
+            return;
+        result = m_result;
+        m_result.id = 0;
+    }
+
+    m_signal_done.emit( result );
+}
+
+void SearchWorker::run()
+{
+    Glib::Mutex::Lock lock( m_mutex );
+    while (true)
+    {
+        while (!m_pending && !m_quit)
+            m_cond.wait( m_mutex );
+
+        if (m_quit)
+            break;
+
+        Request req = m_request;
+        m_pending = false;
+        g_atomic_int_set( &m_cancelled, 0 );
+
+        lock.release();
+        Result result;
+        bool done = search( req, result );
+        snapshot_unref( req.snapshot );
+        lock.acquire();
+
+        //
+        //  A result that was overtaken while the lock was released is
+        //  dropped here, or by on_dispatch().
+        //
+        if (done && req.id == m_last_id)
+        {
+            m_result = result;
+            m_dispatcher.emit();
+        }
+    }
+}
+
+//
+//  Runs on the worker thread. Returns false if the request was
+//  cancelled or the pattern is invalid (as it often is part way
+//  through typing it).
+//
+bool SearchWorker::search( const Request &req, Result &result )
+{
+    GRegex *regex = RegexCache::get()->compile( req.pattern, G_REGEX_MULTILINE );
+    if (!regex)
+        return false;
+
+    const Snapshot *snap = req.snapshot;
+    const gchar *text = snap->text;
+
+    //
+    //  Chunks end at line ends, so only a pattern that can match a
+    //  newline has to be scanned in one go.
+    //
+    gsize chunk = CHUNK_SIZE;
+    if (req.pattern.find( "\\n" ) != std::string::npos ||
+        req.pattern.find( '\n' ) != std::string::npos)
+        chunk = G_MAXSIZE;
+
+    const gchar *origin_ptr = g_utf8_offset_to_pointer( text, req.origin );
+    gsize origin = MIN( (gsize)(origin_ptr - text), snap->len );
+
+    result.id = req.id;
+    result.kind = req.kind;
+    result.start = 0;
+    result.end = 0;
+    result.count = 0;
+    result.index = 0;
+
+    if (req.kind == count_all)
+    {
+        result.found = count( regex, snap, chunk, origin, result.count, result.index );
+        g_regex_unref( regex );
+        return result.found;
+    }
+
+    gsize start = 0, end = 0;
+    bool found;
+    if (req.kind == find_next)
+    {
+        gsize from = (origin < snap->len) ? origin + g_utf8_skip[(guchar)text[origin]] : origin;
+        found = find_forward( regex, snap, chunk, from, snap->len, start, end ) ||
+                find_forward( regex, snap, chunk, 0, from, start, end );
+    }
+    else
+    {
+        found = find_backward( regex, snap, chunk, 0, origin, start, end ) ||
+                find_backward( regex, snap, chunk, origin, snap->len, start, end );
+    }
+
+    g_regex_unref( regex );
+
+    if (g_atomic_int_get( &m_cancelled ))
+        return false;
+
+    result.found = found;
+    if (found)
+    {
+        result.start = g_utf8_pointer_to_offset( text, text + start );
+        result.end = result.start + g_utf8_pointer_to_offset( text + start, text + end );
+    }
+
+    return true;
+}
+
+//
+//  Counts all of the matches, and the ones that start at or before
+//  origin. Returns false if cancelled.
+//
+bool SearchWorker::count( GRegex *regex, const Snapshot *snapshot, gsize chunk,
+                          gsize origin, int &count, int &index )
+{
+    const gchar *text = snapshot->text;
+    gsize len = snapshot->len;
+
+    count = 0;
+    index = 0;
+
+    gsize pos = 0;
+    while (pos < len)
+    {
+        if (g_atomic_int_get( &m_cancelled ))
+            return false;
+
+        gsize limit = len;
+        if (len - pos > chunk)
+        {
+            const gchar *nl = (const gchar*)memchr( text + pos + chunk, '\n',
+                                                    len - pos - chunk );
+            if (nl)
+                limit = nl - text + 1;
+        }
+
+        GMatchInfo *match_info;
+        g_regex_match_full( regex, text, limit, pos,
+                            (GRegexMatchFlags)0, &match_info, NULL );
+        while (g_match_info_matches( match_info ))
+        {
+            gint match_start, match_end;
+            g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+
+            //
+            //  An empty match at the end of the chunk is found again at
+            //  the start of the next one.
+            //
+            if ((gsize)match_start == limit && limit < len)
+                break;
+
+            count++;
+            if ((gsize)match_start <= origin)
+                index = count;
+
+            g_match_info_next( match_info, NULL );
+        }
+        g_match_info_free( match_info );
+
+        pos = limit;
+    }
+
+    return true;
+}
+
+//
+//  Finds the first match that starts in [from, to). Each chunk is
+//  matched up to the end of its last line, so a match that starts
+//  before 'to' isn't cut short.
+//
+bool SearchWorker::find_forward( GRegex *regex, const Snapshot *snapshot, gsize chunk,
+                                 gsize from, gsize to, gsize &start, gsize &end )
+{
+    const gchar *text = snapshot->text;
+    gsize len = snapshot->len;
+
+    gsize pos = from;
+    while (pos < to)
+    {
+        if (g_atomic_int_get( &m_cancelled ))
+            return false;
+
+        gsize limit = len;
+        if (len - pos > chunk)
+        {
+            const gchar *nl = (const gchar*)memchr( text + pos + chunk, '\n',
+                                                    len - pos - chunk );
+            if (nl)
+                limit = nl - text + 1;
+        }
+
+        GMatchInfo *match_info;
+        bool matched = g_regex_match_full( regex, text, limit, pos,
+                                           (GRegexMatchFlags)0, &match_info, NULL );
+        if (matched)
+        {
+            gint match_start, match_end;
+            g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+            g_match_info_free( match_info );
+
+            if ((gsize)match_start >= to)
+                return false;
+
+            start = match_start;
+            end = match_end;
+            return true;
+        }
+        g_match_info_free( match_info );
+
+        pos = limit;
+    }
+
+    return false;
+}
+
+//
+//  Finds the last match that starts in [from, to), working back from
+//  'to' a chunk at a time.
+//
+bool SearchWorker::find_backward( GRegex *regex, const Snapshot *snapshot, gsize chunk,
+                                  gsize from, gsize to, gsize &start, gsize &end )
+{
+    const gchar *text = snapshot->text;
+    gsize len = snapshot->len;
+
+    gsize chunk_to = to;
+    while (chunk_to > from)
+    {
+        if (g_atomic_int_get( &m_cancelled ))
+            return false;
+
+        //
+        //  Start the chunk at the beginning of a line.
+        //
+        gsize chunk_from = from;
+        if (chunk_to - from > chunk)
+        {
+            chunk_from = chunk_to - chunk;
+            while (chunk_from > from && text[chunk_from - 1] != '\n')
+                chunk_from--;
+        }
+
+        gsize limit = len;
+        const gchar *nl = (const gchar*)memchr( text + chunk_to, '\n', len - chunk_to );
+        if (nl)
+            limit = nl - text + 1;
+
+        bool found = false;
+        GMatchInfo *match_info;
+        g_regex_match_full( regex, text, limit, chunk_from,
+                            (GRegexMatchFlags)0, &match_info, NULL );
+        while (g_match_info_matches( match_info ))
+        {
+            gint match_start, match_end;
+            g_match_info_fetch_pos( match_info, 0, &match_start, &match_end );
+            if ((gsize)match_start >= chunk_to)
+                break;
+
+            start = match_start;
+            end = match_end;
+            found = true;
+
+            g_match_info_next( match_info, NULL );
+        }
+        g_match_info_free( match_info );
+
+        if (found)
+            return true;
+
+        chunk_to = chunk_from;
+    }
+
+    return false;
+}
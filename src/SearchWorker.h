@@ -0,0 +1,126 @@
+#ifndef SOURCERER_SEARCH_WORKER_H
+#define SOURCERER_SEARCH_WORKER_H
+
+#include <string>
+
+#include <gtkmm.h>
+
+/**
+ *  Runs searches on a background thread, for search-as-you-type and
+ *  for counting the matches of the last search.
+ *
+ *  Only the latest request matters: posting a new one cancels the one
+ *  being run (the scan checks a flag between chunks of the text) and
+ *  replaces any that hasn't started, and results that have been
+ *  overtaken are never delivered. Results come back on the main loop
+ *  through signal_done().
+ *
+ *  The worker scans a copy of the buffer's text, which is taken once
+ *  and reused until the buffer changes.
+ */
+class SearchWorker
+{
+    public:
+        enum Kind
+        {
+            find_next,          // the first match after origin
+            find_prev,          // the last match before origin
+            count_all           // all matches, and which one is at origin
+        };
+
+        struct Result
+        {
+            guint id;
+            Kind kind;
+            bool found;
+            int start;          // character offsets
+            int end;
+            int count;          // for count_all
+            int index;          // of the last match at or before origin
+        };
+
+        /**
+         *  The scan is split into chunks of about this many bytes,
+         *  ending at line ends, and checks for cancellation between
+         *  them.
+         */
+        static const gsize CHUNK_SIZE = 1024 * 1024;
+
+        SearchWorker();
+        virtual ~SearchWorker();
+
+        /**
+         *  Starts a search for pattern in buffer from the character
+         *  offset origin, wrapping around the end. Returns the id of
+         *  the request, which the result will carry.
+         */
+        guint post( Kind kind,
+                    Glib::RefPtr<Gtk::TextBuffer> buffer,
+                    const std::string &pattern,
+                    int origin );
+
+        /**
+         *  Drops the current request; its result won't be delivered.
+         */
+        void cancel();
+
+        sigc::signal<void, const Result&>& signal_done() { return m_signal_done; }
+
+    protected:
+        /**
+         *  A copy of a buffer's text, shared by the requests using it.
+         */
+        struct Snapshot
+        {
+            gint ref;
+            gchar *text;
+            gsize len;
+        };
+
+        struct Request
+        {
+            guint id;
+            Kind kind;
+            std::string pattern;
+            int origin;
+            Snapshot *snapshot;
+        };
+
+        static Snapshot* snapshot_ref( Snapshot *snapshot );
+        static void snapshot_unref( Snapshot *snapshot );
+
+        void on_buffer_changed();
+        void on_dispatch();
+
+        void run();
+        bool search( const Request &req, Result &result );
+        bool count( GRegex *regex, const Snapshot *snapshot, gsize chunk,
+                    gsize origin, int &count, int &index );
+        bool find_forward( GRegex *regex, const Snapshot *snapshot, gsize chunk,
+                           gsize from, gsize to, gsize &start, gsize &end );
+        bool find_backward( GRegex *regex, const Snapshot *snapshot, gsize chunk,
+                            gsize from, gsize to, gsize &start, gsize &end );
+
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;     // of m_snapshot
+        Snapshot *m_snapshot;
+        sigc::connection m_changed;
+
+        Glib::Thread *m_thread;
+        Glib::Mutex m_mutex;
+        Glib::Cond m_cond;
+        Request m_request;
+        bool m_pending;
+        guint m_last_id;
+        Result m_result;
+        bool m_quit;
+        volatile gint m_cancelled;
+
+        Glib::Dispatcher m_dispatcher;
+        sigc::signal<void, const Result&> m_signal_done;
+
+    private:
+        SearchWorker( const SearchWorker& );
+        SearchWorker& operator=( const SearchWorker& );
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "SwapFile.h"
+
+#include <cstring>
+
+#include <glib/gstdio.h>
+
+const char SWAP_MAGIC[] = "SRCSWAP1";
+const gsize SWAP_MAGIC_LGTH = 8;
+const gsize SWAP_CHECKSUM_LGTH = 40;        // hex SHA-1
+const gsize SWAP_HEADER_LGTH = SWAP_MAGIC_LGTH + SWAP_CHECKSUM_LGTH;
+
+SwapFile::SwapFile() :
+    m_started(false),
+    m_recovered_size(0),
+    m_since_checkpoint(0)
+{
+}
+
+SwapFile::~SwapFile()
+{
+    stop();
+}
+
+std::string SwapFile::get_swap_path( const std::string &path )
+{
+    return Glib::build_filename( Glib::path_get_dirname( path ),
+                                 "." + Glib::path_get_basename( path ) + ".swp" );
+}
+
+bool SwapFile::exists( const std::string &path )
+{
+    return Glib::file_test( get_swap_path( path ), Glib::FILE_TEST_IS_REGULAR );
+}
+
+void SwapFile::discard( const std::string &path )
+{
+    g_unlink( get_swap_path( path ).c_str() );
+}
+
+bool SwapFile::recover( const std::string &path,
+                        const std::string &checksum,
+                        Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    std::string swap_path = get_swap_path( path );
+
+    GMappedFile *mapped = g_mapped_file_new( swap_path.c_str(), FALSE, NULL );
+    if (!mapped)
+        return false;
+
+    const gchar *pos = g_mapped_file_get_contents( mapped );
+    const gchar *end = pos + g_mapped_file_get_length( mapped );
+
+    if (end - pos < (gssize)SWAP_HEADER_LGTH ||
+        memcmp( pos, SWAP_MAGIC, SWAP_MAGIC_LGTH ) != 0)
+    {
+        g_mapped_file_free( mapped );
+        return false;
+    }
+
+    //
+    //  Records apply to the contents the swap file was started from,
+    //  unless it begins with a checkpoint.
+    //
+    const gchar *records = pos + SWAP_HEADER_LGTH;
+    bool same_base = (checksum.size() == SWAP_CHECKSUM_LGTH &&
+                      memcmp( pos + SWAP_MAGIC_LGTH, checksum.data(), SWAP_CHECKSUM_LGTH ) == 0);
+
+    if (!same_base && (records == end || *records != record_checkpoint))
+    {
+        g_mapped_file_free( mapped );
+        return false;
+    }
+
+    GtkTextBuffer *b = buffer->gobj();
+    pos = records;
+
+    //
+    //  Stop at the first record that is incomplete or doesn't fit the
+    //  text; whatever was written before a crash is kept.
+    //
+    while (pos < end)
+    {
+        const gchar *start = pos;
+        gchar type = *pos++;
+        guint32 offset, n;
+        guint64 n_bytes;
+        GtkTextIter iter, iter_end;
+        bool ok = false;
+
+        switch (type)
+        {
+            case record_insert:
+                if (end - pos < 8)
+                    break;
+                memcpy( &offset, pos, 4 );
+                memcpy( &n, pos + 4, 4 );
+                pos += 8;
+                if ((guint64)(end - pos) < n ||
+                    offset > (guint32)gtk_text_buffer_get_char_count( b ))
+                    break;
+
+                gtk_text_buffer_get_iter_at_offset( b, &iter, offset );
+                gtk_text_buffer_insert( b, &iter, pos, n );
+                pos += n;
+                ok = true;
+                break;
+
+            case record_delete:
+                if (end - pos < 8)
+                    break;
+                memcpy( &offset, pos, 4 );
+                memcpy( &n, pos + 4, 4 );
+                pos += 8;
+                if ((guint64)offset + n > (guint64)gtk_text_buffer_get_char_count( b ))
+                    break;
+
+                gtk_text_buffer_get_iter_at_offset( b, &iter, offset );
+                gtk_text_buffer_get_iter_at_offset( b, &iter_end, offset + n );
+                gtk_text_buffer_delete( b, &iter, &iter_end );
+                ok = true;
+                break;
+
+            case record_checkpoint:
+                if (end - pos < 8)
+                    break;
+                memcpy( &n_bytes, pos, 8 );
+                pos += 8;
+                if ((guint64)(end - pos) < n_bytes)
+                    break;
+
+                gtk_text_buffer_set_text( b, pos, n_bytes );
+                pos += n_bytes;
+                ok = true;
+                break;
+        }
+
+        if (!ok)
+        {
+            pos = start;
+            break;
+        }
+    }
+
+    m_recovered_size = pos - g_mapped_file_get_contents( mapped );
+    m_checksum.assign( g_mapped_file_get_contents( mapped ) + SWAP_MAGIC_LGTH,
+                       SWAP_CHECKSUM_LGTH );
+    g_mapped_file_free( mapped );
+
+    return true;
+}
+
+void SwapFile::start( const std::string &path,
+                      const std::string &checksum,
+                      Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    stop();
+
+    m_swap_path = get_swap_path( path );
+    m_buffer = buffer;
+
+    if (m_recovered_size > 0)
+    {
+        //
+        //  Carry on from the recovered swap file (and its base text).
+        //
+        m_writer.reopen( m_swap_path, m_recovered_size );
+        m_started = true;
+        m_recovered_size = 0;
+    }
+    else
+    {
+        m_checksum = checksum;
+    }
+
+    GtkTextBuffer *b = m_buffer->gobj();
+    m_handlers[0] = g_signal_connect( b, "insert-text",
+                                      G_CALLBACK( on_insert_text ), this );
+    m_handlers[1] = g_signal_connect( b, "delete-range",
+                                      G_CALLBACK( on_delete_range ), this );
+
+    m_timer = Glib::signal_timeout().connect(
+                    sigc::mem_fun( *this, &SwapFile::on_timer ), SYNC_INTERVAL );
+}
+
+void SwapFile::stop()
+{
+    if (!m_buffer)
+        return;
+
+    m_timer.disconnect();
+    for (int i = 0; i < 2; ++i)
+        g_signal_handler_disconnect( m_buffer->gobj(), m_handlers[i] );
+    m_buffer = Glib::RefPtr<Gtk::TextBuffer>();
+
+    if (m_started)
+        m_writer.remove();
+
+    m_started = false;
+    m_pending.clear();
+    m_since_checkpoint = 0;
+}
+
+//
+// Protected
+//
+bool SwapFile::on_timer()
+{
+    if (m_pending.empty())
+        return true;
+
+    if (!m_started)
+    {
+        m_writer.create( m_swap_path, make_header() );
+        m_started = true;
+    }
+
+    m_since_checkpoint += m_pending.size();
+
+    m_writer.append( m_pending );
+    m_writer.sync();
+
+    gsize buffer_size = gtk_text_buffer_get_char_count( m_buffer->gobj() );
+    if (m_since_checkpoint > CHECKPOINT_MIN && m_since_checkpoint > buffer_size)
+    {
+        checkpoint();
+    }
+
+    return true;
+}
+
+void SwapFile::checkpoint()
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds( m_buffer->gobj(), &start, &end );
+    gchar *text = gtk_text_iter_get_slice( &start, &end );
+    guint64 n_bytes = strlen( text );
+
+    std::string contents = make_header();
+    contents.reserve( contents.size() + 9 + n_bytes );
+    put<gchar>( contents, record_checkpoint );
+    put<guint64>( contents, n_bytes );
+    contents.append( text, n_bytes );
+    g_free( text );
+
+    m_writer.replace( contents );
+    m_since_checkpoint = 0;
+}
+
+std::string SwapFile::make_header() const
+{
+    std::string header( SWAP_MAGIC, SWAP_MAGIC_LGTH );
+    header += m_checksum;
+    header.resize( SWAP_HEADER_LGTH, '0' );
+    return header;
+}
+
+//
+//  Buffer signal handlers. These only add to m_pending; nothing is
+//  written from the keystroke path.
+//
+void SwapFile::on_insert_text( GtkTextBuffer *buffer, GtkTextIter *location,
+                               gchar *text, gint len, SwapFile *self )
+{
+    std::string &out = self->m_pending;
+    put<gchar>( out, record_insert );
+    put<guint32>( out, gtk_text_iter_get_offset( location ) );
+    put<guint32>( out, len );
+    out.append( text, len );
+}
+
+void SwapFile::on_delete_range( GtkTextBuffer *buffer, GtkTextIter *start,
+                                GtkTextIter *end, SwapFile *self )
+{
+    gint offset = gtk_text_iter_get_offset( start );
+
+    std::string &out = self->m_pending;
+    put<gchar>( out, record_delete );
+    put<guint32>( out, offset );
+    put<guint32>( out, gtk_text_iter_get_offset( end ) - offset );
+}
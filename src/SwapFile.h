@@ -0,0 +1,117 @@
+#ifndef SOURCERER_SWAP_FILE_H
+#define SOURCERER_SWAP_FILE_H
+
+#include <string>
+
+#include <gtkmm.h>
+
+#include "AsyncWriter.h"
+
+/**
+ *  Crash recovery for unsaved changes.
+ *
+ *  Every change to a buffer is added to a journal of compact insert and
+ *  delete records. Records are only collected in memory as edits are
+ *  made; a timer hands them to an AsyncWriter, which appends and fsyncs
+ *  them in the background. Once the journal has grown past the size of
+ *  the buffer it is replaced by a checkpoint holding the whole text.
+ *
+ *  The swap file is kept next to the file (".name.swp") and removed
+ *  when the editor is closed. If one is found when a file is opened,
+ *  its records can be replayed onto the file's contents to get back
+ *  the unsaved text.
+ */
+class SwapFile
+{
+    public:
+        /**
+         *  How often, in milliseconds, collected records are written
+         *  and synced.
+         */
+        static const guint SYNC_INTERVAL = 1000;
+
+        /**
+         *  The journal is never checkpointed before it has grown by
+         *  at least this many bytes.
+         */
+        static const gsize CHECKPOINT_MIN = 1024 * 1024;
+
+        SwapFile();
+        virtual ~SwapFile();
+
+        static std::string get_swap_path( const std::string &path );
+
+        /**
+         *  Returns true if a swap file was left behind for path.
+         */
+        static bool exists( const std::string &path );
+
+        /**
+         *  Removes the swap file for path without reading it.
+         */
+        static void discard( const std::string &path );
+
+        /**
+         *  Replays the swap file for path into buffer, which must hold
+         *  the file's contents as given by checksum (the SHA-1 in hex).
+         *  Returns false if the swap file couldn't be used.
+         */
+        bool recover( const std::string &path,
+                      const std::string &checksum,
+                      Glib::RefPtr<Gtk::TextBuffer> buffer );
+
+        /**
+         *  Starts recording changes to buffer. If the buffer was just
+         *  recovered, new records are added to the recovered swap file.
+         */
+        void start( const std::string &path,
+                    const std::string &checksum,
+                    Glib::RefPtr<Gtk::TextBuffer> buffer );
+
+        /**
+         *  Stops recording and removes the swap file.
+         */
+        void stop();
+
+    protected:
+        enum RecordType
+        {
+            record_insert = 'I',
+            record_delete = 'D',
+            record_checkpoint = 'C'
+        };
+
+        bool on_timer();
+        void checkpoint();
+        std::string make_header() const;
+
+        template <class T>
+        static void put( std::string &out, T value )
+        {
+            out.append( reinterpret_cast<const char*>( &value ), sizeof(T) );
+        }
+
+        static void on_insert_text( GtkTextBuffer *buffer, GtkTextIter *location,
+                                    gchar *text, gint len, SwapFile *self );
+        static void on_delete_range( GtkTextBuffer *buffer, GtkTextIter *start,
+                                     GtkTextIter *end, SwapFile *self );
+
+        std::string m_swap_path;
+        std::string m_checksum;
+
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        gulong m_handlers[2];
+        sigc::connection m_timer;
+
+        AsyncWriter m_writer;
+        bool m_started;             // the writer has been given the file
+        gsize m_recovered_size;     // valid length of a recovered swap file
+        std::string m_pending;      // records not yet handed to the writer
+        gsize m_since_checkpoint;
+
+    private:
+        SwapFile( const SwapFile& );
+        SwapFile& operator=( const SwapFile& );
+};
+
+#endif
@@ -0,0 +1,501 @@
+#include "UndoHistory.h"
+
+#include "utils.h"
+
+UndoHistory::UndoHistory() :
+    m_arena_base(0),
+    m_delta_base(0),
+    m_step_base(0),
+    m_current(0),
+    m_group_depth(0),
+    m_step_open(false),
+    m_applying(false),
+    m_budget(DEFAULT_MEMORY_BUDGET),
+    m_journal(NULL)
+{
+}
+
+UndoHistory::~UndoHistory()
+{
+    set_buffer( Glib::RefPtr<Gtk::TextBuffer>() );
+}
+
+void UndoHistory::set_buffer( Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    if (m_buffer)
+    {
+        for (int i = 0; i < 4; ++i)
+            g_signal_handler_disconnect( m_buffer->gobj(), m_handlers[i] );
+    }
+
+    clear();
+    m_journal = NULL;
+    m_buffer = buffer;
+    m_group_depth = 0;
+
+    if (!m_buffer)
+        return;
+
+    //
+    //  Connect before the default handlers, so deleted text is still
+    //  in the buffer when we see it.
+    //
+    GtkTextBuffer *b = m_buffer->gobj();
+    m_handlers[0] = g_signal_connect( b, "insert-text",
+                                      G_CALLBACK( on_insert_text ), this );
+    m_handlers[1] = g_signal_connect( b, "delete-range",
+                                      G_CALLBACK( on_delete_range ), this );
+    m_handlers[2] = g_signal_connect( b, "begin-user-action",
+                                      G_CALLBACK( on_begin_user_action ), this );
+    m_handlers[3] = g_signal_connect( b, "end-user-action",
+                                      G_CALLBACK( on_end_user_action ), this );
+}
+
+void UndoHistory::set_journal( UndoJournal *journal )
+{
+    clear();
+    m_journal = NULL;
+
+    //
+    //  Journal records count steps from the start of the journal.
+    //
+    m_step_base = 0;
+
+    if (!journal)
+        return;
+
+    //
+    //  Each record is checked against the length the text would have
+    //  by then. The history (and the journal) is cut off at the first
+    //  step that is empty or has a change that doesn't fit, so undo
+    //  and redo never work from text that isn't there.
+    //
+    gint length = m_buffer ? m_buffer->get_char_count() : 0;
+    std::vector<gint> lengths;      // the length before each step
+    bool ok = true;
+
+    UndoJournal::Record r;
+    while (ok && journal->next_record( r ))
+    {
+        switch (r.type)
+        {
+            case UndoJournal::record_step:
+            {
+                if (!m_steps.empty() && m_steps.back().end_delta == m_steps.back().first_delta)
+                {
+                    ok = false;
+                    break;
+                }
+
+                Step step;
+                step.first_delta = m_delta_base + m_deltas.size();
+                step.end_delta = step.first_delta;
+                step.mode_serial = 0;
+                step.in_insert_mode = false;
+                m_steps.push_back( step );
+                lengths.push_back( length );
+                break;
+            }
+
+            case UndoJournal::record_insert:
+            case UndoJournal::record_delete:
+            {
+                if (m_steps.empty() || r.offset < 0 || r.n_chars < 0 || r.offset > length ||
+                    (r.type == UndoJournal::record_delete && r.n_chars > length - r.offset))
+                {
+                    ok = false;
+                    break;
+                }
+                length += (r.type == UndoJournal::record_insert) ? r.n_chars : -r.n_chars;
+
+                //
+                //  The text stays in the journal. All journal deltas
+                //  share the current end of the arena as their position
+                //  so positions still increase from one delta to the next.
+                //
+                Delta d;
+                d.text_pos = m_arena_base + m_arena.size();
+                d.n_bytes = r.n_bytes;
+                d.mapped_text = r.text;
+                d.offset = r.offset;
+                d.n_chars = r.n_chars;
+                d.type = (r.type == UndoJournal::record_insert) ? delta_insert 
+                                                                : delta_delete;
+                m_deltas.push_back( d );
+                m_steps.back().end_delta++;
+                break;
+            }
+
+            case UndoJournal::record_truncate:
+                if (r.n_steps > m_steps.size())
+                {
+                    ok = false;
+                }
+                else if (r.n_steps < m_steps.size())
+                {
+                    length = lengths[r.n_steps];
+                    lengths.resize( r.n_steps );
+                    m_current = r.n_steps;
+                    truncate_redo();
+                }
+                break;
+        }
+    }
+
+    //
+    //  A bad change drops the step it belongs to, and a step record
+    //  after an empty step drops the empty one. An empty last step,
+    //  which a crash between two records can leave, goes too.
+    //
+    guint n_steps = m_steps.size();
+    if (!ok && r.type != UndoJournal::record_truncate && n_steps > 0)
+        n_steps--;
+    if (n_steps > 0 && m_steps[n_steps - 1].end_delta == m_steps[n_steps - 1].first_delta)
+        n_steps--;
+
+    if (!ok || n_steps < m_steps.size())
+    {
+        m_current = n_steps;
+        truncate_redo();
+        journal->cut( n_steps );
+    }
+
+    //
+    //  The buffer holds the text from before the first step.
+    //
+    m_current = 0;
+    m_journal = journal;
+}
+
+bool UndoHistory::can_undo() const
+{
+    return m_current > 0;
+}
+
+bool UndoHistory::can_redo() const
+{
+    return m_current < m_steps.size();
+}
+
+bool UndoHistory::undo()
+{
+    if (!can_undo() || m_group_depth > 0)
+        return false;
+
+    const Step &step = m_steps[--m_current];
+
+    m_applying = true;
+    for (gsize n = step.end_delta; n > step.first_delta; --n)
+    {
+        apply( delta_at( n - 1 ), true );
+    }
+    m_applying = false;
+
+    Gtk::TextIter iter =
+        m_buffer->get_iter_at_offset( delta_at( step.first_delta ).offset );
+    m_buffer->place_cursor( iter );
+
+    return true;
+}
+
+bool UndoHistory::redo()
+{
+    if (!can_redo() || m_group_depth > 0)
+        return false;
+
+    const Step &step = m_steps[m_current++];
+
+    m_applying = true;
+    for (gsize n = step.first_delta; n < step.end_delta; ++n)
+    {
+        apply( delta_at( n ), false );
+    }
+    m_applying = false;
+
+    const Delta &last = delta_at( step.end_delta - 1 );
+    gint offset = last.offset;
+    if (last.type == delta_insert)
+        offset += last.n_chars;
+
+    m_buffer->place_cursor( m_buffer->get_iter_at_offset( offset ) );
+
+    return true;
+}
+
+void UndoHistory::clear()
+{
+    m_arena_base += m_arena.size();
+    m_arena.clear();
+
+    m_delta_base += m_deltas.size();
+    m_deltas.clear();
+
+    m_step_base += m_steps.size();
+    m_steps.clear();
+    m_current = 0;
+    m_step_open = false;
+}
+
+void UndoHistory::set_memory_budget( gsize bytes )
+{
+    m_budget = bytes;
+    enforce_budget();
+}
+
+gsize UndoHistory::get_memory_used() const
+{
+    return m_arena.size() +
+           m_deltas.size() * sizeof(Delta) +
+           m_steps.size() * sizeof(Step);
+}
+
+//
+// Protected
+//
+void UndoHistory::record( DeltaType type, gint offset, const gchar *text, gsize n_bytes )
+{
+    if (m_applying || n_bytes == 0)
+        return;
+
+    truncate_redo();
+
+    bool implicit_group = (m_group_depth == 0);
+    if (implicit_group)
+        begin_group();
+
+    Delta d;
+    d.text_pos = m_arena_base + m_arena.size();
+    d.n_bytes = n_bytes;
+    d.mapped_text = NULL;
+    d.offset = offset;
+    d.n_chars = g_utf8_strlen( text, n_bytes );
+    d.type = type;
+
+    if (!m_step_open)
+    {
+        if (can_merge_step( d ))
+        {
+            m_steps.back().mode_serial = get_vi()->get_mode_serial();
+        }
+        else
+        {
+            Step step;
+            step.first_delta = m_delta_base + m_deltas.size();
+            step.end_delta = step.first_delta;
+            step.mode_serial = get_vi()->get_mode_serial();
+            step.in_insert_mode = (get_vi()->get_mode() == vi_insert);
+            m_steps.push_back( step );
+            m_current = m_steps.size();
+
+            if (m_journal)
+                m_journal->append_step();
+        }
+        m_step_open = true;
+    }
+
+    m_arena.append( text, n_bytes );
+
+    if (m_journal)
+    {
+        m_journal->append_delta( type == delta_insert ? UndoJournal::record_insert
+                                                      : UndoJournal::record_delete,
+                                 offset, d.n_chars, text, n_bytes );
+    }
+
+    //
+    //  Typing and forward deletes extend the previous delta rather
+    //  than adding a new one.
+    //
+    Step &step = m_steps.back();
+    if (step.end_delta > step.first_delta)
+    {
+        Delta &prev = m_deltas.back();
+        bool contiguous_text = (!prev.mapped_text &&
+                                prev.text_pos + prev.n_bytes == d.text_pos);
+
+        if (contiguous_text && prev.type == type &&
+            ((type == delta_insert && prev.offset + prev.n_chars == offset) ||
+             (type == delta_delete && prev.offset == offset)))
+        {
+            prev.n_bytes += d.n_bytes;
+            prev.n_chars += d.n_chars;
+
+            if (implicit_group)
+                end_group();
+            return;
+        }
+    }
+
+    m_deltas.push_back( d );
+    step.end_delta++;
+
+    if (implicit_group)
+        end_group();
+}
+
+void UndoHistory::begin_group()
+{
+    if (m_group_depth++ == 0)
+        m_step_open = false;
+}
+
+void UndoHistory::end_group()
+{
+    if (m_group_depth == 0)
+        return;
+
+    if (--m_group_depth == 0)
+    {
+        m_step_open = false;
+        enforce_budget();
+    }
+}
+
+bool UndoHistory::can_merge_step( const Delta &d ) const
+{
+    //
+    //  Only merge with the newest step, while still in the insert
+    //  session it was started in, and only if the edit is adjacent to
+    //  the last one (typing, or backspacing over what was typed).
+    //
+    if (m_steps.empty() || m_current != m_steps.size())
+        return false;
+
+    const Step &step = m_steps.back();
+    if (!step.in_insert_mode ||
+        get_vi()->get_mode() != vi_insert ||
+        step.mode_serial != get_vi()->get_mode_serial() ||
+        step.end_delta == step.first_delta)
+    {
+        return false;
+    }
+
+    const Delta &prev = m_deltas.back();
+    gint prev_end = prev.offset;
+    if (prev.type == delta_insert)
+        prev_end += prev.n_chars;
+
+    if (d.type == delta_insert)
+        return d.offset == prev_end;
+    else
+        return d.offset + d.n_chars == prev_end || d.offset == prev_end;
+}
+
+void UndoHistory::truncate_redo()
+{
+    if (m_current == m_steps.size())
+        return;
+
+    const Step &first_redo = m_steps[m_current];
+
+    if (m_journal)
+        m_journal->append_truncate( m_step_base + m_current );
+
+    //
+    //  Redo steps are always the newest, so their deltas and text are
+    //  at the ends of the deque and the arena.
+    //
+    gsize n_deltas = first_redo.first_delta - m_delta_base;
+    if (n_deltas < m_deltas.size())
+    {
+        m_arena.resize( m_deltas[n_deltas].text_pos - m_arena_base );
+        m_deltas.resize( n_deltas );
+    }
+
+    m_steps.resize( m_current );
+}
+
+void UndoHistory::enforce_budget()
+{
+    if (m_group_depth > 0)
+        return;
+
+    //
+    //  The newest undo step is always kept, however large it is, so
+    //  the last change can be undone.
+    //
+    while (m_current > 1 && get_memory_used() > m_budget)
+    {
+        drop_oldest_step();
+    }
+}
+
+void UndoHistory::drop_oldest_step()
+{
+    const Step &step = m_steps.front();
+
+    while (m_delta_base < step.end_delta)
+    {
+        m_deltas.pop_front();
+        m_delta_base++;
+    }
+
+    m_steps.pop_front();
+    m_step_base++;
+    m_current--;
+
+    //
+    //  Release arena space lazily: only move the remaining text down
+    //  once the dead space at the front outweighs it, so the cost of
+    //  dropping steps stays proportional to what is dropped.
+    //
+    gsize live_start = m_deltas.empty() ? m_arena_base + m_arena.size()
+                                        : m_deltas.front().text_pos;
+    gsize dead = live_start - m_arena_base;
+
+    if (dead > 0 && dead >= m_arena.size() - dead)
+    {
+        m_arena.erase( 0, dead );
+        m_arena_base = live_start;
+    }
+}
+
+void UndoHistory::apply( const Delta &d, bool reverse )
+{
+    GtkTextBuffer *buffer = m_buffer->gobj();
+    GtkTextIter start;
+    gtk_text_buffer_get_iter_at_offset( buffer, &start, d.offset );
+
+    bool insert = (d.type == delta_insert) != reverse;
+
+    if (insert)
+    {
+        gtk_text_buffer_insert( buffer, &start, text_of( d ), d.n_bytes );
+    }
+    else
+    {
+        GtkTextIter end;
+        gtk_text_buffer_get_iter_at_offset( buffer, &end, d.offset + d.n_chars );
+        gtk_text_buffer_delete( buffer, &start, &end );
+    }
+}
+
+//
+//  Buffer signal handlers
+//
+void UndoHistory::on_insert_text( GtkTextBuffer *buffer, GtkTextIter *location,
+                                  gchar *text, gint len, UndoHistory *self )
+{
+    self->record( delta_insert, gtk_text_iter_get_offset( location ), text, len );
+}
+
+void UndoHistory::on_delete_range( GtkTextBuffer *buffer, GtkTextIter *start,
+                                   GtkTextIter *end, UndoHistory *self )
+{
+    if (self->m_applying)
+        return;
+
+    gchar *text = gtk_text_iter_get_slice( start, end );
+    self->record( delta_delete, gtk_text_iter_get_offset( start ), text, strlen( text ) );
+    g_free( text );
+}
+
+void UndoHistory::on_begin_user_action( GtkTextBuffer *buffer, UndoHistory *self )
+{
+    self->begin_group();
+}
+
+void UndoHistory::on_end_user_action( GtkTextBuffer *buffer, UndoHistory *self )
+{
+    self->end_group();
+}
@@ -0,0 +1,152 @@
+#ifndef SOURCERER_UNDO_HISTORY_H
+#define SOURCERER_UNDO_HISTORY_H
+
+#include <deque>
+#include <string>
+
+#include <gtkmm.h>
+
+#include "UndoJournal.h"
+
+/**
+ *  Undo/redo history for a text buffer.
+ *
+ *  Every change to the buffer is recorded as a delta: the character
+ *  offset it happened at and the text inserted or removed. The text of
+ *  all deltas is kept in a single append-only arena, so a change costs
+ *  one small record plus its bytes. Changes made inside one user action
+ *  form a single undo step, and adjacent edits made during the same
+ *  insert mode session are merged into one step as well.
+ *
+ *  Instead of a fixed number of levels the history is limited by a
+ *  memory budget. When it is exceeded the oldest steps are dropped
+ *  (the newest step is always kept).
+ *
+ *  The history can also be kept in an UndoJournal. Steps restored from
+ *  a journal are read in place from the mapped file, and count only
+ *  their index entries against the budget.
+ */
+class UndoHistory
+{
+    public:
+        static const gsize DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+        UndoHistory();
+        virtual ~UndoHistory();
+
+        /**
+         *  Starts recording changes to buffer. Any existing history
+         *  is discarded.
+         */
+        void set_buffer( Glib::RefPtr<Gtk::TextBuffer> buffer );
+
+        /**
+         *  Restores the history saved in journal and records all new
+         *  history to it. The buffer is assumed to hold the text the
+         *  journal was started from, so restored steps can be redone.
+         *  Passing NULL stops journaling.
+         */
+        void set_journal( UndoJournal *journal );
+
+        bool can_undo() const;
+        bool can_redo() const;
+
+        /**
+         *  Reverts (or reapplies) one step and places the cursor where
+         *  it happened. Returns false if there was nothing to do.
+         */
+        bool undo();
+        bool redo();
+
+        /**
+         *  Discards all history.
+         */
+        void clear();
+
+        void set_memory_budget( gsize bytes );
+        gsize get_memory_budget() const { return m_budget; }
+
+        /**
+         *  Bytes currently used by the recorded history.
+         */
+        gsize get_memory_used() const;
+
+    protected:
+        enum DeltaType
+        {
+            delta_insert,
+            delta_delete
+        };
+
+        struct Delta
+        {
+            gsize text_pos;         // absolute position in the arena
+            gsize n_bytes;
+            const gchar *mapped_text;   // text in the journal, or NULL
+            gint offset;            // character offset in the buffer
+            gint n_chars;
+            DeltaType type;
+        };
+
+        struct Step
+        {
+            gsize first_delta;      // absolute delta numbers [first, end)
+            gsize end_delta;
+            guint mode_serial;      // see ViKeyManager::get_mode_serial()
+            bool in_insert_mode;
+        };
+
+        void record( DeltaType type, gint offset, const gchar *text, gsize n_bytes );
+
+        void begin_group();
+        void end_group();
+
+        bool can_merge_step( const Delta &d ) const;
+        void truncate_redo();
+        void enforce_budget();
+        void drop_oldest_step();
+
+        void apply( const Delta &d, bool reverse );
+
+        Delta& delta_at( gsize n ) { return m_deltas[n - m_delta_base]; }
+        const gchar* text_of( const Delta &d ) const
+        {
+            if (d.mapped_text)
+                return d.mapped_text;
+            return m_arena.data() + (d.text_pos - m_arena_base);
+        }
+
+        static void on_insert_text( GtkTextBuffer *buffer, GtkTextIter *location,
+                                    gchar *text, gint len, UndoHistory *self );
+        static void on_delete_range( GtkTextBuffer *buffer, GtkTextIter *start,
+                                     GtkTextIter *end, UndoHistory *self );
+        static void on_begin_user_action( GtkTextBuffer *buffer, UndoHistory *self );
+        static void on_end_user_action( GtkTextBuffer *buffer, UndoHistory *self );
+
+        Glib::RefPtr<Gtk::TextBuffer> m_buffer;
+        gulong m_handlers[4];
+
+        std::string m_arena;
+        gsize m_arena_base;         // absolute position of m_arena[0]
+
+        std::deque<Delta> m_deltas;
+        gsize m_delta_base;         // absolute number of m_deltas[0]
+
+        std::deque<Step> m_steps;
+        gsize m_step_base;          // absolute number of m_steps[0]
+        gsize m_current;            // steps before this index can be undone
+
+        int m_group_depth;
+        bool m_step_open;           // a step has been started for this group
+        bool m_applying;            // ignore our own undo/redo changes
+
+        gsize m_budget;
+
+        UndoJournal *m_journal;
+
+    private:
+        UndoHistory( const UndoHistory& );
+        UndoHistory& operator=( const UndoHistory& );
+};
+
+#endif
@@ -0,0 +1,268 @@
+#include "UndoJournal.h"
+
+#include <cstring>
+
+const char JOURNAL_MAGIC[] = "SRCUNDO1";
+const gsize JOURNAL_MAGIC_LGTH = 8;
+const gsize JOURNAL_CHECKSUM_LGTH = 40;     // hex SHA-1
+const gsize JOURNAL_HEADER_LGTH = JOURNAL_MAGIC_LGTH + JOURNAL_CHECKSUM_LGTH;
+
+UndoJournal::UndoJournal() :
+    m_mapped(NULL),
+    m_read_pos(NULL),
+    m_read_end(NULL),
+    m_started(false),
+    m_create(true),
+    m_full(false),
+    m_size(0),
+    m_record_start(0)
+{
+}
+
+UndoJournal::~UndoJournal()
+{
+    close();
+
+    if (m_mapped)
+        g_mapped_file_free( m_mapped );
+}
+
+void UndoJournal::open( const std::string &path, const std::string &checksum )
+{
+    close();
+
+    if (m_mapped)
+    {
+        g_mapped_file_free( m_mapped );
+        m_mapped = NULL;
+    }
+    m_read_pos = m_read_end = NULL;
+
+    m_journal_path = get_journal_path( path );
+    m_checksum = checksum;
+
+    m_started = false;
+    m_create = true;
+    m_full = false;
+    m_size = 0;
+    m_record_start = 0;
+    m_step_starts.clear();
+
+    m_mapped = g_mapped_file_new( m_journal_path.c_str(), FALSE, NULL );
+    if (!m_mapped)
+        return;
+
+    const gchar *data = g_mapped_file_get_contents( m_mapped );
+    gsize size = g_mapped_file_get_length( m_mapped );
+
+    if (size < JOURNAL_HEADER_LGTH ||
+        memcmp( data, JOURNAL_MAGIC, JOURNAL_MAGIC_LGTH ) != 0 ||
+        m_checksum.size() != JOURNAL_CHECKSUM_LGTH ||
+        memcmp( data + JOURNAL_MAGIC_LGTH, m_checksum.data(), JOURNAL_CHECKSUM_LGTH ) != 0)
+    {
+        //
+        //  The file has changed since this journal was written (or
+        //  the journal is damaged). It is replaced on the first write.
+        //
+        g_mapped_file_free( m_mapped );
+        m_mapped = NULL;
+        return;
+    }
+
+    m_read_pos = data + JOURNAL_HEADER_LGTH;
+    m_read_end = data + size;
+    m_size = JOURNAL_HEADER_LGTH;
+    m_create = false;
+}
+
+void UndoJournal::close()
+{
+    m_writer.close();
+}
+
+template <class T>
+bool UndoJournal::get( T &value )
+{
+    if ((gsize)(m_read_end - m_read_pos) < sizeof(T))
+        return false;
+
+    memcpy( &value, m_read_pos, sizeof(T) );
+    m_read_pos += sizeof(T);
+    return true;
+}
+
+bool UndoJournal::next_record( Record &r )
+{
+    if (m_read_pos == NULL || m_read_pos >= m_read_end)
+        return false;
+
+    const gchar *start = m_read_pos;
+    m_record_start = m_size;
+
+    guint8 tag;
+    guint32 offset, n_chars, n_bytes;
+
+    bool ok = get( tag );
+    if (ok)
+    {
+        r.type = (RecordType)tag;
+        switch (tag)
+        {
+            case record_step:
+                break;
+
+            case record_insert:
+            case record_delete:
+                ok = get( offset ) && get( n_chars ) && get( n_bytes ) &&
+                     (gsize)(m_read_end - m_read_pos) >= n_bytes;
+                if (ok)
+                {
+                    r.offset = offset;
+                    r.n_chars = n_chars;
+                    r.n_bytes = n_bytes;
+                    r.text = m_read_pos;
+                    m_read_pos += n_bytes;
+                }
+                break;
+
+            case record_truncate:
+                ok = get( n_bytes );
+                r.n_steps = n_bytes;
+                break;
+
+            default:
+                ok = false;
+        }
+    }
+
+    if (!ok)
+    {
+        //
+        //  A partly written record (from a crash, say) ends the
+        //  journal. It is cut off before anything new is appended.
+        //
+        m_read_pos = m_read_end = NULL;
+        return false;
+    }
+
+    m_size += m_read_pos - start;
+
+    if (r.type == record_step)
+        m_step_starts.push_back( m_record_start );
+    else if (r.type == record_truncate && r.n_steps < m_step_starts.size())
+        m_step_starts.resize( r.n_steps );
+
+    return true;
+}
+
+void UndoJournal::cut( guint n_steps )
+{
+    if (n_steps < m_step_starts.size())
+    {
+        m_size = m_step_starts[n_steps];
+        m_step_starts.resize( n_steps );
+    }
+    else
+    {
+        m_size = m_record_start;
+    }
+
+    //
+    //  The rest is cut off before anything new is appended.
+    //
+    m_read_pos = m_read_end = NULL;
+}
+
+void UndoJournal::append_step()
+{
+    std::string rec;
+    put<guint8>( rec, record_step );
+    gsize n = rec.size();
+    if (queue( rec ))
+        m_step_starts.push_back( m_size - n );
+}
+
+void UndoJournal::append_delta( RecordType type, gint offset, gint n_chars,
+                                const gchar *text, gsize n_bytes )
+{
+    std::string rec;
+    rec.reserve( 13 + n_bytes );
+    put<guint8>( rec, type );
+    put<guint32>( rec, offset );
+    put<guint32>( rec, n_chars );
+    put<guint32>( rec, n_bytes );
+    rec.append( text, n_bytes );
+    queue( rec );
+}
+
+void UndoJournal::append_truncate( guint n_steps )
+{
+    std::string rec;
+    put<guint8>( rec, record_truncate );
+    put<guint32>( rec, n_steps );
+    if (queue( rec ) && n_steps < m_step_starts.size())
+        m_step_starts.resize( n_steps );
+}
+
+//
+// Protected
+//
+std::string UndoJournal::get_journal_path( const std::string &path )
+{
+    gchar *name = g_compute_checksum_for_string( G_CHECKSUM_SHA1, path.c_str(), -1 );
+    std::string file( name );
+    g_free( name );
+
+    return Glib::build_filename( Glib::get_user_cache_dir(),
+                                 "sourcerer",
+                                 "undo",
+                                 file + ".undo" );
+}
+
+bool UndoJournal::queue( std::string &data )
+{
+    if (m_journal_path.empty() || m_full)
+        return false;
+
+    if (m_size + data.size() > MAX_SIZE)
+    {
+        //
+        //  Nothing after a dropped record can be kept: the steps read
+        //  back would be missing its text. A dropped change also takes
+        //  the rest of its step with it (only this session's steps can
+        //  have been written in part).
+        //
+        m_full = true;
+        if (m_started && data[0] != record_step && data[0] != record_truncate &&
+            !m_step_starts.empty())
+        {
+            m_size = m_step_starts.back();
+            m_step_starts.pop_back();
+            m_writer.reopen( m_journal_path, m_size );
+        }
+        return false;
+    }
+
+    if (!m_started)
+    {
+        //
+        //  Nothing touches the disk until there is something to record.
+        //
+        if (m_create)
+        {
+            std::string header( JOURNAL_MAGIC, JOURNAL_MAGIC_LGTH );
+            header += m_checksum;
+            m_writer.create( m_journal_path, header );
+            m_size = header.size();
+        }
+        else
+        {
+            m_writer.reopen( m_journal_path, m_size );
+        }
+        m_started = true;
+    }
+
+    m_size += data.size();
+    m_writer.append( data );
+    return true;
+}
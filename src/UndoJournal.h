@@ -0,0 +1,123 @@
+#ifndef SOURCERER_UNDO_JOURNAL_H
+#define SOURCERER_UNDO_JOURNAL_H
+
+#include <string>
+#include <vector>
+
+#include <gtkmm.h>
+
+#include "AsyncWriter.h"
+
+/**
+ *  An append-only, on-disk copy of a file's undo history, so that the
+ *  history survives closing and reopening the file.
+ *
+ *  Journals live in the user's cache directory, one per file path. The
+ *  header holds a checksum of the file's contents when it was opened;
+ *  the history is only restored if the file still has the same
+ *  contents. An existing journal is mapped into memory and read in
+ *  place: its records are indexed, but no text is copied and nothing
+ *  is applied to the buffer.
+ *
+ *  New records are written by an AsyncWriter, so recording history
+ *  never waits on the disk.
+ */
+class UndoJournal
+{
+    public:
+        enum RecordType
+        {
+            record_step = 'S',      // starts a new undo step
+            record_insert = 'I',
+            record_delete = 'D',
+            record_truncate = 'T'   // drops all steps after n_steps
+        };
+
+        struct Record
+        {
+            RecordType type;
+            gint offset;
+            gint n_chars;
+            gsize n_bytes;
+            const gchar *text;      // points into the mapped journal
+            guint n_steps;
+        };
+
+        /**
+         *  Journals stop growing once they reach this size. The first
+         *  record that doesn't fit ends the journal; if it was part of
+         *  a step, the step is cut off too, so no step is left with
+         *  some of its changes missing.
+         */
+        static const gsize MAX_SIZE = 512 * 1024 * 1024;
+
+        UndoJournal();
+        virtual ~UndoJournal();
+
+        /**
+         *  Opens the journal for the file at path. checksum is the
+         *  SHA-1 (in hex) of the file's contents. If a journal for the
+         *  same contents exists it is mapped and can be read with
+         *  next_record().
+         */
+        void open( const std::string &path, const std::string &checksum );
+
+        /**
+         *  Stops journaling and waits for queued records to be written.
+         */
+        void close();
+
+        /**
+         *  Reads the next record of the existing journal. Returns false
+         *  at the end, or if there was no usable journal.
+         */
+        bool next_record( Record &r );
+
+        /**
+         *  Stops reading the existing journal and drops everything
+         *  from step n_steps on (counting from the start of the
+         *  journal), or, if there are fewer steps, from the record just
+         *  read. Used when the records don't fit the file.
+         */
+        void cut( guint n_steps );
+
+        void append_step();
+        void append_delta( RecordType type, gint offset, gint n_chars,
+                           const gchar *text, gsize n_bytes );
+        void append_truncate( guint n_steps );
+
+    protected:
+        static std::string get_journal_path( const std::string &path );
+
+        bool queue( std::string &data );
+
+        template <class T>
+        static void put( std::string &out, T value )
+        {
+            out.append( reinterpret_cast<const char*>( &value ), sizeof(T) );
+        }
+
+        template <class T>
+        bool get( T &value );
+
+        std::string m_journal_path;
+        std::string m_checksum;
+
+        GMappedFile *m_mapped;
+        const gchar *m_read_pos;
+        const gchar *m_read_end;
+
+        AsyncWriter m_writer;
+        bool m_started;             // the writer has been given the file
+        bool m_create;              // replace any stale journal on first write
+        bool m_full;                // a record didn't fit; nothing more is written
+        gsize m_size;
+        gsize m_record_start;       // where the record last read starts
+        std::vector<gsize> m_step_starts;   // where each live step starts
+
+    private:
+        UndoJournal( const UndoJournal& );
+        UndoJournal& operator=( const UndoJournal& );
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <gtkmm.h>
 
+#include "ViRegister.h"
+
 enum ViMode
 {
     vi_normal,
@@ -11,12 +13,6 @@ enum ViMode
     vi_visual
 };
 
-enum ViOperatorScope 
-{
-    vi_characterwise,
-    vi_linewise
-};
-
 enum ActionFlags {
     await_motion = 0x01,
     await_param = 0x02,
@@ -74,12 +70,6 @@ const unsigned int vi_key_map_lgth = sizeof( vi_key_map ) / sizeof( vi_key_map[0
 GdkEventKey* str_to_key(const Glib::ustring &str);
 Glib::ustring key_to_str( GdkEventKey *event );
 
-struct ViRegisterValue
-{
-    ViOperatorScope scope;
-    Glib::ustring text;
-};
-
 /**
  *  Interface class for displaying messages to the user.
  */
@@ -137,6 +127,15 @@ class ViModeHandler
 
         virtual int get_cmd_count() = 0;
         virtual Glib::ustring get_cmd_params() = 0;
+
+        /**
+         *  Gets the line range given to the current ex command. Returns
+         *  the number of addresses given; first and last are only set
+         *  if it isn't 0.
+         */
+        virtual int get_cmd_range( int &first, int &last ) { return 0; }
+
+        virtual bool get_cmd_bang() { return false; }
 };
 
 #endif
@@ -1,16 +1,29 @@
+#include <algorithm>
+
 #include "ViCommandMode.h"
 
 #include "App.h"
 #include "Editor.h"
 #include "ViKeyManager.h"
+#include "actions.h"
 #include "utils.h"
 
+//
+//  How long, in milliseconds, typing has to pause before the pattern
+//  is searched for.
+//
+const guint INCSEARCH_DELAY = 50;
+
 ViCommandMode::ViCommandMode(ViKeyManager *vi) :
     m_vi(vi),
     m_cmd(""),
     m_history_it(),
-    m_history()
+    m_history(),
+    m_cmd_count(0),
+    m_search_view(NULL)
 {
+    m_search_worker.signal_done().connect(
+        sigc::mem_fun(*this, &ViCommandMode::on_incsearch_done) );
 }
 
 ViCommandMode::~ViCommandMode()
@@ -25,10 +38,14 @@ void ViCommandMode::enter_mode( ViMode from_mode )
     m_cmd = m_vi->get_last_key();
     m_vi->show_message(m_cmd.data());
     m_history_it = m_history.begin();
+
+    if (m_cmd == "/" || m_cmd == "?")
+        start_incsearch();
 }
 
 void ViCommandMode::exit_mode( ViMode to_mode )
 {
+    end_incsearch();
     m_cmd = "";
     m_vi->show_message("");
 }
@@ -42,6 +59,10 @@ ViCommandMode::handle_key_press( const Glib::ustring &key_str )
     }
     else if (key_str == "<CR>")
     {
+        //
+        //  The search proper starts from where the cursor was.
+        //
+        end_incsearch();
         execute( m_cmd );
 
         m_vi->set_mode(vi_normal);
@@ -70,6 +91,8 @@ ViCommandMode::handle_key_press( const Glib::ustring &key_str )
         m_cmd += key_str;
     }
 
+    update_incsearch();
+
     m_vi->show_message("%s", m_cmd.data());
     return true;
 }
@@ -79,7 +102,25 @@ void ViCommandMode::map_key( const Glib::ustring &widget_type,
                              ExecutableAction *a )
 {
     if (key[0] == ':')
-        m_commandMap[key.substr(1)] = a;
+    {
+        ExCommandDef def;
+        def.name = key.substr(1);
+        def.min_lgth = def.name.find('[');
+        def.action = a;
+
+        if (def.min_lgth == Glib::ustring::npos)
+        {
+            def.min_lgth = def.name.length();
+        }
+        else
+        {
+            //  ":d[elete]" -> "delete", which can be shortened to "d"
+            def.name.erase( def.name.length() - 1 );
+            def.name.erase( def.min_lgth, 1 );
+        }
+
+        m_commands.push_back( def );
+    }
     else
         m_keyMap[key] = a;
 }
@@ -121,55 +162,202 @@ void ViCommandMode::execute_search(const Glib::ustring &cmd, char begin )
     //
     int count = 1;              
     int offset = 0;
-    Glib::ustring pattern;
+    Glib::ustring pattern = get_search_pattern( Glib::ustring(1, begin) + cmd );
 
     int idx = cmd.find( begin ); 
     if (idx > 0)
     {
         Glib::ustring rest = cmd.substr(idx+1);
         offset = convert<int>(rest);
-
-        pattern = cmd.substr(0, idx);
-    }
-    else
-    {
-        pattern = cmd;
     }
 
     Direction dir = Forward;
     if (begin == '?')  
         dir = Backward;
 
+    //
+    //  An empty pattern means the last one, highlighting included.
+    //
+    if (pattern.empty())
+        pattern = m_vi->get_last_search();
+    if (pattern.empty())
+    {
+        m_vi->show_error( "E35: No previous regular expression" );
+        return;
+    }
+
     g_print("Searching for %s with offset %i\n", pattern.data(), offset);
 
+    m_vi->set_last_search( pattern, dir );
+
     Editor *ed = Application::get()->get_current_editor();
     ed->search(pattern, dir);
     
 }
 
-void ViCommandMode::execute_command(const Glib::ustring &cmd_line)
+void ViCommandMode::start_incsearch()
 {
-    // TODO: more intelligent parsing
-    Glib::ustring cmd;
-    int idx = cmd_line.find_first_of(' ');
-    if (idx > 0)
+    Gtk::Widget *w = get_focused_widget();
+    if (!is_text_widget(w))
+        return;
+
+    m_search_view = static_cast<Gtk::TextView*>(w);
+    Glib::RefPtr<Gtk::TextBuffer> buffer = m_search_view->get_buffer();
+    m_search_origin = buffer->create_mark( buffer->get_iter_at_mark( buffer->get_insert() ) );
+}
+
+void ViCommandMode::update_incsearch()
+{
+    if (!m_search_view)
+        return;
+
+    m_search_timer.disconnect();
+    m_search_worker.cancel();
+
+    if (get_search_pattern( m_cmd ).empty())
     {
-        m_cmd_params = cmd_line.substr(idx+1);
-        cmd = cmd_line.substr(0, idx);
+        restore_incsearch_cursor();
+        return;
     }
-    else
+
+    //
+    //  Wait for a pause in the typing; a search still being run for an
+    //  older pattern has already been stopped.
+    //
+    m_search_timer = Glib::signal_timeout().connect(
+        sigc::mem_fun(*this, &ViCommandMode::on_incsearch_timeout), INCSEARCH_DELAY );
+}
+
+void ViCommandMode::end_incsearch()
+{
+    if (!m_search_view)
+        return;
+
+    m_search_timer.disconnect();
+    m_search_worker.cancel();
+
+    restore_incsearch_cursor();
+    m_search_view->get_buffer()->delete_mark( m_search_origin );
+    m_search_origin.clear();
+    m_search_view = NULL;
+}
+
+bool ViCommandMode::on_incsearch_timeout()
+{
+    Glib::RefPtr<Gtk::TextBuffer> buffer = m_search_view->get_buffer();
+    int origin = buffer->get_iter_at_mark( m_search_origin ).get_offset();
+
+    m_search_worker.post( m_cmd[0] == '?' ? SearchWorker::find_prev : SearchWorker::find_next,
+                          buffer, get_search_pattern( m_cmd ).raw(), origin );
+    return false;
+}
+
+void ViCommandMode::on_incsearch_done(const SearchWorker::Result &result)
+{
+    if (!m_search_view)
+        return;
+
+    if (!result.found)
     {
-        cmd = cmd_line;
-        m_cmd_params = "";
+        restore_incsearch_cursor();
+        return;
     }
 
-    g_print("Command %s with params '%s'\n", cmd.data(), m_cmd_params.data());
+    Glib::RefPtr<Gtk::TextBuffer> buffer = m_search_view->get_buffer();
+    Gtk::TextIter start = buffer->get_iter_at_offset( result.start );
+    Gtk::TextIter end = buffer->get_iter_at_offset( result.end );
 
-    ExecutableAction *act = m_commandMap[cmd];
-    if (act)
+    buffer->select_range( start, end );
+    m_search_view->scroll_to( start, 0.1 );
+}
+
+void ViCommandMode::restore_incsearch_cursor()
+{
+    Glib::RefPtr<Gtk::TextBuffer> buffer = m_search_view->get_buffer();
+    buffer->place_cursor( buffer->get_iter_at_mark( m_search_origin ) );
+    m_search_view->scroll_to( m_search_origin );
+}
+
+//
+//  The pattern of a "/pattern/offset" or "?pattern?offset" command.
+//
+Glib::ustring ViCommandMode::get_search_pattern(const Glib::ustring &cmd)
+{
+    if (cmd.empty())
+        return "";
+
+    Glib::ustring rest = cmd.substr(1);
+    Glib::ustring::size_type idx = rest.find( cmd[0] );
+    if (idx != Glib::ustring::npos && idx > 0)
+        return rest.substr(0, idx);
+    return rest;
+}
+
+bool ViCommandMode::execute_command(const Glib::ustring &cmd_line)
+{
+    //
+    //  Addresses refer to the focused text, if any. Commands such as
+    //  ":q" work without one.
+    //
+    Glib::RefPtr<Gtk::TextBuffer> buffer;
+    Gtk::Widget *w = get_focused_widget();
+    if (is_text_widget(w))
+        buffer = static_cast<Gtk::TextView*>(w)->get_buffer();
+
+    if (!m_ex.parse( cmd_line, buffer ))
+    {
+        m_vi->show_error( "%s", m_ex.get_error().c_str() );
+        return false;
+    }
+
+    m_cmd_params = m_ex.get_args();
+    m_cmd_count = (m_ex.get_addr_count() > 0) ? m_ex.get_line2() : 0;
+
+    if (m_ex.get_name().empty())
+    {
+        //
+        //  A range on its own goes to its last line.
+        //
+        if (m_ex.get_addr_count() > 0)
+            goto_specific_line( std::max( m_ex.get_line2(), 1 ) );
+        return true;
+    }
+
+    ExecutableAction *act = find_command( m_ex.get_name() );
+    if (!act)
     {
-        act->execute();
+        m_vi->show_error( "E492: Not an editor command: %s", cmd_line.c_str() );
+        return false;
     }
+
+    act->execute();
+    return true;
+}
+
+ExecutableAction* ViCommandMode::find_command( const Glib::ustring &name )
+{
+    //
+    //  An exact match wins, otherwise the first command that name
+    //  abbreviates.
+    //
+    ExCommandList::iterator it;
+    for (it = m_commands.begin(); it != m_commands.end(); ++it)
+    {
+        if (it->name == name)
+            return it->action;
+    }
+
+    for (it = m_commands.begin(); it != m_commands.end(); ++it)
+    {
+        if (name.length() >= it->min_lgth &&
+            name.length() <= it->name.length() &&
+            it->name.compare( 0, name.length(), name ) == 0)
+        {
+            return it->action;
+        }
+    }
+
+    return NULL;
 }
 
 void ViCommandMode::add_history(const Glib::ustring &cmd)
@@ -238,3 +426,18 @@ Glib::ustring ViCommandMode::get_cmd_params()
     return m_cmd_params;
 }
 
+int ViCommandMode::get_cmd_range( int &first, int &last )
+{
+    if (m_ex.get_addr_count() > 0)
+    {
+        first = m_ex.get_line1();
+        last = m_ex.get_line2();
+    }
+    return m_ex.get_addr_count();
+}
+
+bool ViCommandMode::get_cmd_bang()
+{
+    return m_ex.get_bang();
+}
+
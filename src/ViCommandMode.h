@@ -1,6 +1,10 @@
 #ifndef VI_COMMAND_MODE_H
 #define VI_COMMAND_MODE_H
 
+#include <vector>
+
+#include "ExCommandLine.h"
+#include "SearchWorker.h"
 #include "Vi.h"
 
 class ViCommandMode : public ViModeHandler
@@ -19,12 +23,49 @@ class ViCommandMode : public ViModeHandler
 
         void execute(const Glib::ustring &cmd);
 
+        /**
+         *  Runs an ex command line (without the ':'). Returns false if
+         *  it couldn't be parsed or isn't a command.
+         */
+        bool execute_command(const Glib::ustring &cmd);
+
         int get_cmd_count();
         Glib::ustring get_cmd_params();
+        int get_cmd_range( int &first, int &last );
+        bool get_cmd_bang();
 
     protected:
+        /**
+         *  An ex command. Commands are mapped as ":name" or, with an
+         *  abbreviation, ":na[me]"; min_lgth is the length of the
+         *  shortest abbreviation.
+         */
+        struct ExCommandDef
+        {
+            Glib::ustring name;
+            Glib::ustring::size_type min_lgth;
+            ExecutableAction *action;
+        };
+        typedef std::vector<ExCommandDef> ExCommandList;
+
+        ExecutableAction* find_command( const Glib::ustring &name );
+
         void execute_search(const Glib::ustring &pattern, char begin);
-        void execute_command(const Glib::ustring &cmd);
+
+        /**
+         *  Search-as-you-type. While a / or ? command is typed, each
+         *  version of the pattern is looked for on a worker thread,
+         *  after a short pause in the typing, and the nearest match is
+         *  selected. Leaving the command line puts the cursor back.
+         */
+        void start_incsearch();
+        void update_incsearch();
+        void end_incsearch();
+        bool on_incsearch_timeout();
+        void on_incsearch_done(const SearchWorker::Result &result);
+        void restore_incsearch_cursor();
+
+        static Glib::ustring get_search_pattern(const Glib::ustring &cmd);
 
         void add_history(const Glib::ustring &cmd);
         Glib::ustring next_history(Direction d, char begin);
@@ -33,13 +74,19 @@ class ViCommandMode : public ViModeHandler
         Glib::ustring m_cmd;
 
         KeyActionMap m_keyMap;
-        KeyActionMap m_commandMap;
+        ExCommandList m_commands;
+        ExCommandLine m_ex;
 
         std::list<std::string> m_history;
         std::list<std::string>::iterator m_history_it;
 
         int m_cmd_count;
         Glib::ustring m_cmd_params;
+
+        SearchWorker m_search_worker;
+        Gtk::TextView *m_search_view;
+        Glib::RefPtr<Gtk::TextBuffer::Mark> m_search_origin;
+        sigc::connection m_search_timer;
 };
 
 #endif
@@ -1,15 +1,16 @@
-
 #include "ViInsertMode.h"
 
 #include "App.h"
 #include "utils.h"
 
-ViInsertMode::ViInsertMode()
+ViInsertMode::ViInsertMode() :
+    m_pending_view(NULL)
 {
 }
 
 ViInsertMode::~ViInsertMode()
 {
+    m_flush_conn.disconnect();
     m_keyMap.clear();   
 }
 
@@ -21,6 +22,7 @@ void ViInsertMode::enter_mode( ViMode from_mode )
 
 void ViInsertMode::exit_mode( ViMode to_mode )
 {
+    flush_pending();
 }
 
 bool 
@@ -28,16 +30,55 @@ ViInsertMode::handle_key_press( const Glib::ustring &str )
 {
     Gtk::Widget *w = get_focused_widget();
 
-    const char *type = G_OBJECT_TYPE_NAME(w->gobj());
-    Glib::ustring type_str(type);
-    ExecutableAction *action = lookup(m_keyMap, type_str, str);
+    if (!m_keyMap.empty())
+    {
+        const char *type = G_OBJECT_TYPE_NAME(w->gobj());
+        Glib::ustring type_str(type);
+        ExecutableAction *action = lookup(m_keyMap, type_str, str);
+
+        if (action)
+        {
+            flush_pending();
+            action->execute();
+            return true;
+        }
+    }
 
-    if (action)
+    //
+    //  Printable characters go straight into the buffer. Overwrite
+    //  (replace) mode is left to the widget.
+    //
+    gunichar ch = get_printable_char( str );
+    if (ch != 0 && is_text_widget(w))
     {
-        action->execute();
-        return true;
+        Gtk::TextView *view = static_cast<Gtk::TextView*>(w);
+
+        if (!view->get_overwrite())
+        {
+            if (view != m_pending_view)
+            {
+                flush_pending();
+                m_pending_view = view;
+            }
+
+            m_pending += ch;
+
+            if (!m_flush_conn.connected())
+            {
+                //
+                //  High idle priority runs after all queued key events
+                //  have been handled, but before GTK redraws.
+                //
+                m_flush_conn = Glib::signal_idle().connect(
+                        sigc::mem_fun( *this, &ViInsertMode::on_flush_idle ),
+                        Glib::PRIORITY_HIGH_IDLE );
+            }
+            return true;
+        }
     }
 
+    flush_pending();
+
     //
     //  Pass the key press on
     //
@@ -54,10 +95,72 @@ ViInsertMode::handle_key_press( const Glib::ustring &str )
                              "key-press-event", 
                              event,
                              &ret_val );
+    gdk_event_free( (GdkEvent*)event );
     return false;
 
 }
 
+void ViInsertMode::flush_pending()
+{
+    m_flush_conn.disconnect();
+
+    if (m_pending.empty() || !m_pending_view)
+    {
+        m_pending.clear();
+        return;
+    }
+
+    Glib::RefPtr<Gtk::TextBuffer> buffer = m_pending_view->get_buffer();
+    bool editable = m_pending_view->get_editable();
+
+    //
+    //  Same as the text view does for a typed character: replace
+    //  the selection, then insert at the cursor.
+    //
+    buffer->begin_user_action();
+    buffer->erase_selection( true, editable );
+    buffer->insert_interactive_at_cursor( m_pending, editable );
+    buffer->end_user_action();
+
+    m_pending_view->scroll_to( buffer->get_insert() );
+
+    m_pending.clear();
+}
+
+bool ViInsertMode::on_flush_idle()
+{
+    flush_pending();
+    return false;
+}
+
+gunichar ViInsertMode::get_printable_char( const Glib::ustring &str )
+{
+    if (str.length() == 1)
+    {
+        return str[0];
+    }
+
+    if (str == "<Space>")
+    {
+        return ' ';
+    }
+
+    //
+    //  Keys outside of ASCII come through as <0x...> (their keyval) 
+    //  when no modifier is held.
+    //
+    if (str.length() > 4 && str.compare( 0, 3, "<0x" ) == 0)
+    {
+        guint keyval = strtoul( str.substr( 3 ).data(), NULL, 16 );
+        gunichar ch = gdk_keyval_to_unicode( keyval );
+
+        if (ch != 0 && g_unichar_isprint( ch ))
+            return ch;
+    }
+
+    return 0;
+}
+
 void ViInsertMode::map_key( const Glib::ustring &widget_type, 
                             const Glib::ustring &key,
                             ExecutableAction *a )
@@ -66,6 +169,7 @@ void ViInsertMode::map_key( const Glib::ustring &widget_type,
     if ( !map )
     {
         map = new KeyActionMap();
+        m_keyMap[widget_type] = map;
     }
 
     (*map)[key] = a;
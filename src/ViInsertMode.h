@@ -19,8 +19,30 @@ class ViInsertMode : public ViModeHandler
 
         int get_cmd_count() { return 0; }
         Glib::ustring get_cmd_params() { return ""; }
+        /**
+         *  Inserts any typed text that is still waiting for the
+         *  next idle callback.
+         */
+        void flush_pending();
+
     protected:
+        /**
+         *  Returns the character for a printable key string, or 0
+         *  if the key should be handled by the widget.
+         */
+        gunichar get_printable_char( const Glib::ustring &key_str );
+
+        bool on_flush_idle();
+
         WidgetToKeyActionMap m_keyMap;
+
+        //
+        //  Typed characters are collected here and inserted once per
+        //  main loop iteration, before the view is redrawn.
+        //
+        Glib::ustring m_pending;
+        Gtk::TextView *m_pending_view;
+        sigc::connection m_flush_conn;
 };
 
 #endif
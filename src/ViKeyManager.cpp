@@ -6,6 +6,7 @@
 #include "ViNormalMode.h"
 #include "ViInsertMode.h"
 #include "ViCommandMode.h"
+#include "SearchHighlighter.h"
 #include "utils.h"
 
 
@@ -22,7 +23,9 @@ ViKeyManager::ViKeyManager(Gtk::Window *w, ViUserMessageArea *msg_area) :
     m_mode(vi_normal),
     m_msg_area(msg_area),
     m_registers(),
-    m_window(w)
+    m_window(w),
+    m_mode_serial(0),
+    m_input_held(0)
 {
     m_handlers[vi_normal] = new ViNormalMode(this);
     m_handlers[vi_insert] = new ViInsertMode();
@@ -31,6 +34,12 @@ ViKeyManager::ViKeyManager(Gtk::Window *w, ViUserMessageArea *msg_area) :
 
 ViKeyManager::~ViKeyManager()
 {
+    while (!m_pending_keys.empty())
+    {
+        gdk_event_free( (GdkEvent*)m_pending_keys.front() );
+        m_pending_keys.pop_front();
+    }
+
     delete m_msg_area;
 }
 
@@ -46,6 +55,12 @@ bool ViKeyManager::execute( Glib::ustring &cmds )
     return execute( cmds, m_mode );    
 }
 
+bool ViKeyManager::execute_command( const Glib::ustring &cmd_line )
+{
+    ViCommandMode *handler = static_cast<ViCommandMode*>( m_handlers[vi_command] );
+    return handler->execute_command( cmd_line );
+}
+
 bool ViKeyManager::execute( Glib::ustring &cmds, ViMode mode )
 {
     set_mode( mode );
@@ -133,6 +148,18 @@ bool ViKeyManager::on_key_press( GdkEventKey *event )
         return true;
     }
 
+    if (m_input_held > 0)
+    {
+        if (event->keyval == GDK_Escape && !m_signal_cancel.empty())
+        {
+            m_signal_cancel.emit();
+            return true;
+        }
+
+        m_pending_keys.push_back( (GdkEventKey*)gdk_event_copy( (GdkEvent*)event ) );
+        return true;
+    }
+
     m_last_key = key_to_str( event );
 
     //
@@ -166,17 +193,29 @@ void ViKeyManager::set_current_register( char reg )
     m_current_register = reg;
 }
 
-ViRegisterValue ViKeyManager::get_register( char reg )
+Glib::RefPtr<ViRegisterValue> ViKeyManager::get_register( char reg )
 {
-    return m_registers[reg]; 
+    std::map<char, Glib::RefPtr<ViRegisterValue> >::iterator it;
+
+    it = m_registers.find( reg );
+    if (it == m_registers.end())
+    {
+        return Glib::RefPtr<ViRegisterValue>();
+    }
+    return it->second;
 }
 
-void ViKeyManager::set_register( char reg, Glib::ustring text )
+void ViKeyManager::set_register( char reg, const Glib::ustring &text )
 {
     set_register( reg, text, vi_characterwise );
 }
 
-void ViKeyManager::set_register( char reg, Glib::ustring text, ViOperatorScope scope )
+void ViKeyManager::set_register( char reg, const Glib::ustring &text, ViOperatorScope scope )
+{
+    set_register( reg, ViTextChunk::create( text ), scope );
+}
+
+void ViKeyManager::set_register( char reg, Glib::RefPtr<ViTextChunk> chunk, ViOperatorScope scope )
 {
     //
     //  Upper case register values append text
@@ -184,15 +223,15 @@ void ViKeyManager::set_register( char reg, Glib::ustring text, ViOperatorScope s
     if (isupper( reg ))
     {
         reg = tolower( reg ); 
-        ViRegisterValue v = get_register( reg );
-        text = v.text + text;
+        Glib::RefPtr<ViRegisterValue> v = get_register( reg );
+        if (v)
+        {
+            m_registers[reg] = v->append( chunk, scope );
+            return;
+        }
     }
 
-    ViRegisterValue val;
-    val.scope = scope;
-    val.text = text;
-
-    m_registers[reg] = val;
+    m_registers[reg] = ViRegisterValue::create( chunk, scope );
 }
 
 ViMode ViKeyManager::get_mode() const
@@ -215,6 +254,16 @@ Glib::ustring ViKeyManager::get_cmd_params()
     return m_handlers[m_mode]->get_cmd_params();
 }
 
+int ViKeyManager::get_cmd_range( int &first, int &last )
+{
+    return m_handlers[m_mode]->get_cmd_range( first, last );
+}
+
+bool ViKeyManager::get_cmd_bang()
+{
+    return m_handlers[m_mode]->get_cmd_bang();
+}
+
 bool ViKeyManager::get_extend_selection()
 {
     return m_ext_selection;
@@ -230,6 +279,7 @@ void ViKeyManager::set_mode( ViMode m )
     ViModeHandler *old_handler = m_handlers[m_mode];
     ViMode old = m_mode;
     m_mode = m;
+    m_mode_serial++;
     ViModeHandler *new_handler = m_handlers[m_mode];
 
     old_handler->exit_mode( m_mode );
@@ -244,6 +294,40 @@ void ViKeyManager::set_mode( ViMode m )
 */
 }
 
+guint ViKeyManager::get_mode_serial() const
+{
+    return m_mode_serial;
+}
+
+void ViKeyManager::hold_input()
+{
+    m_input_held++;
+}
+
+void ViKeyManager::release_input()
+{
+    if (m_input_held > 0)
+        m_input_held--;
+
+    //
+    //  A replayed key may hold input again (another paste, for
+    //  example), in which case the rest stay queued.
+    //
+    while (m_input_held == 0 && !m_pending_keys.empty())
+    {
+        GdkEventKey *event = m_pending_keys.front();
+        m_pending_keys.pop_front();
+
+        on_key_press( event );
+        gdk_event_free( (GdkEvent*)event );
+    }
+}
+
+sigc::signal<void>& ViKeyManager::signal_cancel()
+{
+    return m_signal_cancel;
+}
+
 void ViKeyManager::perfom_last_search()
 {
     Editor* ed = Application::get()->get_current_editor();
@@ -255,5 +339,12 @@ void ViKeyManager::set_last_search( const Glib::ustring &search, Direction d )
 {
     m_last_search = search;
     m_last_search_direction = d;
+
+    SearchHighlighter::set_pattern( search );
+}
+
+Glib::ustring ViKeyManager::get_last_search() const
+{
+    return m_last_search;
 }
 
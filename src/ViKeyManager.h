@@ -1,6 +1,8 @@
 #ifndef VI_KEY_MANAGER_H
 #define VI_KEY_MANAGER_H
 
+#include <deque>
+
 #include <gtkmm.h>
 
 #include "Vi.h"
@@ -30,15 +32,31 @@ class ViKeyManager
         virtual bool execute( Glib::ustring &cmds );
         virtual bool execute( Glib::ustring &cmds, ViMode mode );
 
+        /**
+         *  Runs an ex command line (without the ':'). Returns false if
+         *  it isn't a valid command.
+         */
+        bool execute_command( const Glib::ustring &cmd_line );
+
         virtual void show_message( const char *format, ... );
         virtual void show_error( const char *format, ... );
 
         char get_current_register();
         void set_current_register( char reg );
 
-        ViRegisterValue get_register( char reg );
-        void set_register( char reg, Glib::ustring text );
-        void set_register( char reg, Glib::ustring text, ViOperatorScope scope );
+        /**
+         *  Gets the value of a register. The value is shared, not
+         *  copied, and is empty (NULL) if the register was never set.
+         */
+        Glib::RefPtr<ViRegisterValue> get_register( char reg );
+        void set_register( char reg, const Glib::ustring &text );
+        void set_register( char reg, const Glib::ustring &text, ViOperatorScope scope );
+
+        /**
+         *  Stores chunk in a register. Upper case registers append
+         *  the chunk to the current value instead of replacing it.
+         */
+        void set_register( char reg, Glib::RefPtr<ViTextChunk> chunk, ViOperatorScope scope );
 
         /**
          * Gets the current ViMode
@@ -57,6 +75,18 @@ class ViKeyManager
          *  Retreives the paramaters for the current command, if any.
          */
         Glib::ustring get_cmd_params();
+
+        /**
+         *  Retrieves the line range (from 1) of the current ex command.
+         *  Returns the number of addresses given, which is 0 when there
+         *  was no range.
+         */
+        int get_cmd_range( int &first, int &last );
+
+        /**
+         *  Returns true if the current ex command was given a '!'.
+         */
+        bool get_cmd_bang();
         
         /**
          *  Returns a boolean to indicate if motion commands should
@@ -70,15 +100,38 @@ class ViKeyManager
          */
         void set_mode( ViMode mode );
 
+        /**
+         *  Returns a number that changes every time the mode changes.
+         *  Used to tell whether two events happened in the same
+         *  insert session, for example.
+         */
+        guint get_mode_serial() const;
+
+        /**
+         *  Holds keyboard input. Key presses received while input is
+         *  held are queued, and replayed in order when the matching
+         *  release_input() is called. Calls may be nested.
+         */
+        void hold_input();
+        void release_input();
+
+        /**
+         *  Emitted when <Esc> is pressed while input is held, to cancel
+         *  whatever is holding it. If nothing is connected the key is
+         *  queued like any other.
+         */
+        sigc::signal<void>& signal_cancel();
+
         void perfom_last_search();
         void set_last_search( const Glib::ustring &search, Direction d );
+        Glib::ustring get_last_search() const;
 
     private:
         ViMode m_mode;
         Gtk::Window *m_window;
 
         char m_current_register;       // the register to use for the next operation. (0x00 means no register) 
-        std::map<char, ViRegisterValue> m_registers;
+        std::map<char, Glib::RefPtr<ViRegisterValue> > m_registers;
 
         ViModeHandler *m_handlers[4];
 
@@ -89,6 +142,11 @@ class ViKeyManager
         Direction m_last_search_direction;
 
         bool m_ext_selection;
+        guint m_mode_serial;
+
+        int m_input_held;
+        std::deque<GdkEventKey*> m_pending_keys;
+        sigc::signal<void> m_signal_cancel;
 };
 
 
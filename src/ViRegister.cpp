@@ -0,0 +1,133 @@
+#include "ViRegister.h"
+
+//
+//  ViTextChunk
+//
+Glib::RefPtr<ViTextChunk> ViTextChunk::create( gchar *text, gsize length )
+{
+    return Glib::RefPtr<ViTextChunk>( new ViTextChunk( text, length ) );
+}
+
+Glib::RefPtr<ViTextChunk> ViTextChunk::create( const Glib::ustring &text )
+{
+    gsize length = text.bytes();
+    return create( g_strndup( text.data(), length ), length );
+}
+
+ViTextChunk::ViTextChunk( gchar *text, gsize length ) :
+    m_data(text),
+    m_length(length),
+    m_ref_count(1)
+{
+}
+
+ViTextChunk::~ViTextChunk()
+{
+    g_free( m_data );
+}
+
+void ViTextChunk::reference() const
+{
+    g_atomic_int_inc( &m_ref_count );
+}
+
+void ViTextChunk::unreference() const
+{
+    if (g_atomic_int_dec_and_test( &m_ref_count ))
+        delete this;
+}
+
+//
+//  ViRegisterValue
+//
+Glib::RefPtr<ViRegisterValue>
+ViRegisterValue::create( Glib::RefPtr<ViTextChunk> chunk, ViOperatorScope scope )
+{
+    return Glib::RefPtr<ViRegisterValue>(
+                    new ViRegisterValue( chunk, scope, NULL ) );
+}
+
+Glib::RefPtr<ViRegisterValue>
+ViRegisterValue::append( Glib::RefPtr<ViTextChunk> chunk,
+                         ViOperatorScope scope ) const
+{
+    //
+    //  A linewise append makes the whole register linewise, as in Vim.
+    //
+    if (m_scope == vi_linewise)
+        scope = vi_linewise;
+
+    return Glib::RefPtr<ViRegisterValue>(
+                    new ViRegisterValue( chunk, scope, this ) );
+}
+
+ViRegisterValue::ViRegisterValue( Glib::RefPtr<ViTextChunk> chunk,
+                                  ViOperatorScope scope,
+                                  const ViRegisterValue *prev ) :
+    m_scope(scope),
+    m_chunk(chunk),
+    m_prev(prev),
+    m_length(chunk->get_length()),
+    m_n_chunks(1),
+    m_ref_count(1)
+{
+    if (m_prev)
+    {
+        m_prev->reference();
+        m_length += m_prev->m_length;
+        m_n_chunks += m_prev->m_n_chunks;
+    }
+}
+
+ViRegisterValue::~ViRegisterValue()
+{
+}
+
+void ViRegisterValue::get_chunks(
+                std::vector< Glib::RefPtr<ViTextChunk> > &chunks ) const
+{
+    //
+    //  The chain runs from the newest chunk back to the oldest.
+    //
+    chunks.resize( m_n_chunks );
+
+    guint idx = m_n_chunks;
+    for (const ViRegisterValue *v = this; v != NULL; v = v->m_prev)
+    {
+        chunks[--idx] = v->m_chunk;
+    }
+}
+
+Glib::ustring ViRegisterValue::get_text() const
+{
+    std::vector< Glib::RefPtr<ViTextChunk> > chunks;
+    get_chunks( chunks );
+
+    std::string text;
+    text.reserve( m_length );
+    for (guint i = 0; i < chunks.size(); ++i)
+    {
+        text.append( chunks[i]->get_data(), chunks[i]->get_length() );
+    }
+    return text;
+}
+
+void ViRegisterValue::reference() const
+{
+    g_atomic_int_inc( &m_ref_count );
+}
+
+void ViRegisterValue::unreference() const
+{
+    //
+    //  Release the chain iteratively so that a register that has been
+    //  appended to many times doesn't recurse once per chunk.
+    //
+    const ViRegisterValue *v = this;
+    while (v && g_atomic_int_dec_and_test( &v->m_ref_count ))
+    {
+        const ViRegisterValue *prev = v->m_prev;
+        delete v;
+        v = prev;
+    }
+}
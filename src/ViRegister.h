@@ -0,0 +1,114 @@
+#ifndef VI_REGISTER_H
+#define VI_REGISTER_H
+
+#include <vector>
+
+#include <gtkmm.h>
+
+enum ViOperatorScope
+{
+    vi_characterwise,
+    vi_linewise
+};
+
+/**
+ *  An immutable, reference counted piece of text. The text is never
+ *  copied once a chunk is created, so the same chunk can be shared by
+ *  several registers and by a paste that is still in progress.
+ */
+class ViTextChunk
+{
+    public:
+        /**
+         *  Creates a chunk that takes ownership of text, which must
+         *  have been allocated with g_malloc (for example, the result
+         *  of gtk_text_buffer_get_text).
+         */
+        static Glib::RefPtr<ViTextChunk> create( gchar *text, gsize length );
+
+        /**
+         *  Creates a chunk holding a copy of text.
+         */
+        static Glib::RefPtr<ViTextChunk> create( const Glib::ustring &text );
+
+        const gchar* get_data() const { return m_data; }
+        gsize get_length() const { return m_length; }
+
+        void reference() const;
+        void unreference() const;
+
+    protected:
+        ViTextChunk( gchar *text, gsize length );
+        ~ViTextChunk();
+
+        gchar *m_data;
+        gsize m_length;
+        mutable gint m_ref_count;
+
+    private:
+        ViTextChunk( const ViTextChunk& );
+        ViTextChunk& operator=( const ViTextChunk& );
+};
+
+/**
+ *  The value of a register: a list of text chunks and the scope they
+ *  were yanked with.
+ *
+ *  Values are immutable and shared. Appending (as done for upper case
+ *  registers) creates a new value that points back at the old one, so
+ *  it costs one allocation no matter how much text is already held.
+ */
+class ViRegisterValue
+{
+    public:
+        static Glib::RefPtr<ViRegisterValue> create(
+                                    Glib::RefPtr<ViTextChunk> chunk,
+                                    ViOperatorScope scope );
+
+        /**
+         *  Returns a new value holding this value's text followed by
+         *  chunk. This value is left untouched.
+         */
+        Glib::RefPtr<ViRegisterValue> append( Glib::RefPtr<ViTextChunk> chunk,
+                                              ViOperatorScope scope ) const;
+
+        ViOperatorScope get_scope() const { return m_scope; }
+
+        /**
+         *  Total length, in bytes, of the text held by the register.
+         */
+        gsize get_length() const { return m_length; }
+
+        /**
+         *  Fills chunks with the text chunks, in order.
+         */
+        void get_chunks( std::vector< Glib::RefPtr<ViTextChunk> > &chunks ) const;
+
+        /**
+         *  Returns the text as a single string. This copies the text,
+         *  so it should only be used for small values.
+         */
+        Glib::ustring get_text() const;
+
+        void reference() const;
+        void unreference() const;
+
+    protected:
+        ViRegisterValue( Glib::RefPtr<ViTextChunk> chunk,
+                         ViOperatorScope scope,
+                         const ViRegisterValue *prev );
+        ~ViRegisterValue();
+
+        ViOperatorScope m_scope;
+        Glib::RefPtr<ViTextChunk> m_chunk;
+        const ViRegisterValue *m_prev;  // holds a reference
+        gsize m_length;
+        guint m_n_chunks;
+        mutable gint m_ref_count;
+
+    private:
+        ViRegisterValue( const ViRegisterValue& );
+        ViRegisterValue& operator=( const ViRegisterValue& );
+};
+
+#endif
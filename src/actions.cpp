@@ -5,6 +5,7 @@
 #include "App.h"
 #include "actions.h"
 #include "Editor.h"
+#include "PasteJob.h"
 #include "utils.h"
 #include "ViTextIter.h"
 
@@ -81,10 +82,9 @@ void choose_register()
 //
 //  Helper function for yank and delete
 //
-Glib::ustring do_yank( Gtk::Widget *w, bool del = false, ViOperatorScope scope = vi_characterwise)
+void do_yank( Gtk::Widget *w, bool del = false, ViOperatorScope scope = vi_characterwise)
 {
     ViKeyManager *vi = get_vi();
-    Glib::ustring text;
     if (is_text_widget(w))
     {
         Gtk::TextView *view = static_cast<Gtk::TextView*>(w);
@@ -94,23 +94,25 @@ Glib::ustring do_yank( Gtk::Widget *w, bool del = false, ViOperatorScope scope =
         Gtk::TextIter end;
 
         buffer->get_selection_bounds(start, end);
-        text = buffer->get_text(start, end);
 
-        char r = vi->get_current_register();
+        //
+        //  Use the C API so the register can take ownership of the
+        //  text rather than copying it into a Glib::ustring.
+        //
+        gchar *text = gtk_text_buffer_get_text( buffer->gobj(),
+                                                start.gobj(),
+                                                end.gobj(),
+                                                TRUE );
 
-        vi->set_register(r, text, scope);
-
-        if (r != 0x00)
-            g_print("Set %c with \"%s\"\n", r, text.data());
-        else
-            g_print("Set default register with \"%s\"\n", text.data());
+        vi->set_register( vi->get_current_register(),
+                          ViTextChunk::create( text, strlen( text ) ),
+                          scope );
 
         if (del)
         {
             buffer->erase(start, end);
         }
     }
-    return text;
 }
 
 void delete_text()
@@ -321,14 +323,10 @@ void undo()
     Gtk::Widget *w = get_focused_widget();
     if ( is_source_view( w ) )
     { 
-        gtksourceview::SourceView *view = 
-            static_cast<gtksourceview::SourceView*>(w); 
-
-        Glib::RefPtr< gtksourceview::SourceBuffer > buffer = 
-            view->get_source_buffer();
+        Editor *ed = Application::get()->get_current_editor();
 
-        if ( buffer->can_undo() )
-            buffer->undo();
+        if ( !ed->undo() )
+            get_vi()->show_message( "Already at oldest change" );
     }
     return;
 }
@@ -339,14 +337,10 @@ void redo()
 
     if ( is_source_view( w ) )
     { 
-        gtksourceview::SourceView *view = 
-            static_cast<gtksourceview::SourceView*>(w); 
-
-        Glib::RefPtr< gtksourceview::SourceBuffer > buffer = 
-            view->get_source_buffer();
+        Editor *ed = Application::get()->get_current_editor();
 
-        if ( buffer->can_redo() )
-            buffer->redo();
+        if ( !ed->redo() )
+            get_vi()->show_message( "Already at newest change" );
     }
     return;
 }
@@ -464,10 +458,13 @@ void search_word_under_cursor(Direction dir)
         //  Make sure the word is properly escaped and then add the
         //  boundry assertion.
         //
-        gchar *esc = g_regex_escape_string( word.data(), word.length() );
+        gchar *esc = g_regex_escape_string( word.data(), word.bytes() );
         word = "\\b";
         word += esc;
         word += "\\b";
+        g_free( esc );
+
+        get_vi()->set_last_search( word, dir );
 
         Editor *ed = Application::get()->get_current_editor();
         if ( !ed->search(word, dir, get_vi()->get_extend_selection()) )
@@ -652,24 +649,45 @@ void application_quit()
     Application::get()->quit();
 }
 
+void interrupt_scheme()
+{
+    Application::get()->get_scheme()->cancel();
+}
+
 void open_file()
 {
-    SourceEditor *e = Gtk::manage(new SourceEditor()); 
+    open_path( get_vi()->get_cmd_params() );
+}
 
+SourceEditor* open_path( const Glib::ustring &path )
+{
     EditorArea *ea = Application::get()->get_main_window()->get_editor_area();
 
-    Glib::ustring params = get_vi()->get_cmd_params();
+    //
+    //  Editors are keyed by absolute path.
+    //
+    Glib::ustring abs_path = Gio::File::create_for_path(path)->get_path();
 
-    if (e->open(params))
+    SourceEditor *e = ea->get_editor_for_file(abs_path);
+    if (e)
     {
-        ea->add_editor(e);
-        g_print("Added page for file %s\n", params.data());
+        ea->set_current_page(ea->page_num(*e));
+        return e;
     }
-    else
+
+    e = Gtk::manage(new SourceEditor()); 
+
+    if (e->open(path))
     {
-        g_print("Error could not open file %s\n", params.data());
-        get_vi()->show_error("Error: could not open file %s", params.data());
+        ea->add_editor(e);
+        g_print("Added page for file %s\n", path.data());
+        return e;
     }
+
+    g_print("Error could not open file %s\n", path.data());
+    get_vi()->show_error("Error: could not open file %s", path.data());
+    delete e;
+    return NULL;
 }
 
 void close_current_file()
@@ -729,7 +747,11 @@ void put_text(Direction dir)
 {
     char r = get_vi()->get_current_register();
 
-    ViRegisterValue val = get_vi()->get_register(r);
+    Glib::RefPtr<ViRegisterValue> val = get_vi()->get_register(r);
+    if (!val)
+    {
+        return;
+    }
 
     Gtk::Widget *w = get_focused_widget();
     if (is_text_widget(w))
@@ -739,7 +761,7 @@ void put_text(Direction dir)
 
         ViTextIter cursor = get_cursor_iter( buffer ); 
 
-        if (val.scope == vi_characterwise)
+        if (val->get_scope() == vi_characterwise)
         {
             if (dir == Forward)
                 cursor.forward_char();
@@ -752,7 +774,25 @@ void put_text(Direction dir)
                 cursor.set_line_offset(0);
         }
 
-        buffer->insert(cursor, val.text);
+        if (val->get_length() >= PasteJob::THRESHOLD)
+        {
+            PasteJob::start( buffer, cursor, val );
+            return;
+        }
+
+        //
+        //  Insert straight from the register's chunks. The insert
+        //  revalidates the iterator to point after the new text.
+        //
+        std::vector< Glib::RefPtr<ViTextChunk> > chunks;
+        val->get_chunks( chunks );
+
+        Gtk::TextIter iter = cursor;
+        for (guint i = 0; i < chunks.size(); ++i)
+        {
+            const gchar *data = chunks[i]->get_data();
+            iter = buffer->insert( iter, data, data + chunks[i]->get_length() );
+        }
     }
 
 }
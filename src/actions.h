@@ -4,6 +4,8 @@
 #include "ViKeyManager.h"
 #include "ViMotionAction.h"
 
+class SourceEditor;
+
 /**
  *  Cursor movement commands.
  */
@@ -145,8 +147,19 @@ void put_text(Direction dir);
  */
 void change_focus( Gtk::DirectionType dir );
 
+/**
+ *  Interrupts the Scheme expression being evaluated.
+ */
+void interrupt_scheme();
+
 void open_file();
 
+/**
+ *  Switches to the editor for path, opening the file if it isn't
+ *  open already. Returns NULL if it couldn't be opened.
+ */
+SourceEditor* open_path( const Glib::ustring &path );
+
 void close_file();
 
 #endif
@@ -0,0 +1,20 @@
+;; filling, updating and emptying hash tables with string, symbol and integer keys
+(define (churn n)
+  (let ((by-name (make-hash-table))
+        (by-symbol (make-hash-table))
+        (by-line (make-hash-table)))
+    (do ((i 0 (+ i 1)))
+        ((= i n))
+      (let ((name (number->string i)))
+        (hash-table-set! by-name name i)
+        (hash-table-set! by-symbol (string->symbol name) i)
+        (hash-table-set! by-line i name)))
+    (do ((i 0 (+ i 1)))
+        ((= i n))
+      (hash-table-set! by-line i (+ (hash-table-ref by-name (number->string i)) 1))
+      (if (even? i)
+          (hash-table-set! by-name (number->string i) #f)))))
+
+(do ((i 0 (+ i 1)))
+    ((= i 10))
+  (churn 20000))
@@ -0,0 +1,20 @@
+;; reading a data file a line at a time, and reading it back as Scheme
+(call-with-output-file "bench-lines.txt"
+  (lambda (p)
+    (do ((i 0 (+ i 1)))
+        ((= i 50000))
+      (format p "(line ~D \"some text on the line\" ~A)~%" i (* i 1.5)))))
+
+(do ((i 0 (+ i 1)))
+    ((= i 10))
+  (call-with-input-file "bench-lines.txt"
+    (lambda (p)
+      (let loop ((line (read-line p)))
+        (if (not (eof-object? line))
+            (loop (read-line p)))))))
+
+(call-with-input-file "bench-lines.txt"
+  (lambda (p)
+    (let loop ((form (read p)))
+      (if (not (eof-object? form))
+          (loop (read p))))))
@@ -0,0 +1,12 @@
+;; building and taking apart strings, the way a script edits lines
+(define (build-line n)
+  (let ((line ""))
+    (do ((i 0 (+ i 1)))
+        ((= i n) line)
+      (set! line (string-append line (number->string i) " ")))))
+
+(do ((i 0 (+ i 1)))
+    ((= i 2000))
+  (let ((line (build-line 40)))
+    (substring line 10 (string-length line))
+    (string->list line)))
@@ -62,6 +62,7 @@ typedef double s7_Double;
    *    port-line-number        current line during loading
    *    port-filename           current file name during loading
    *    gc                      calls the GC. If its argument is #f, the GC is turned off
+   *    gc-history              a list describing the most recent collections (see s7_gc_history below)
    *    quit                    exits s7
    *    call-with-exit          just like call/cc but jump back into a context
    *    continuation?           #t if its argument is a continuation (as opposed to an ordinary procedure)
@@ -220,6 +221,25 @@ s7_pointer s7_gc_on(s7_scheme *sc, bool on);
 void s7_gc_stats(s7_scheme *sc, bool on);
 void s7_remove_from_heap(s7_scheme *sc, s7_pointer x);
 
+typedef struct {
+  unsigned int number;       /* collections so far, counting this one */
+  double time;               /* when it happened (seconds since s7_init) */
+  double pause;              /* seconds evaluation was stopped for the mark */
+  double sweep;              /* seconds spent sweeping (spread over the allocations that followed) */
+  unsigned int live;         /* cells found in use */
+  unsigned int freed;        /* cells free once the sweep was done */
+  unsigned int heap_size;    /* cells in the heap */
+  double alloc_rate;         /* cells allocated per second since the previous collection */
+} s7_gc_record;
+
+int s7_gc_history(s7_scheme *sc, s7_gc_record *records, int size);
+
+  /* s7 keeps a record of each of the last 64 collections (whether or not *gc-stats* is on).
+   *   s7_gc_history copies up to size of them, oldest first, into records, and returns how many
+   *   it copied.  A collection is recorded once the heap has been swept.  In Scheme, (gc-history)
+   *   returns the same records as a list of alists: ((number . 12) (time . 3.5) (pause . 0.004) ...).
+   */
+
   /* any s7_pointer object held in C (as a local variable for example) needs to be
    *   protected from garbage collection if there is any chance the GC may run without
    *   an existing Scheme-level reference to that object.  s7_gc_protect places the
@@ -357,8 +377,9 @@ s7_pointer s7_hash_table_ref(s7_scheme *sc, s7_pointer table, s7_pointer key);
                                                                             /* (hash-table-ref table key) */
 s7_pointer s7_hash_table_set(s7_scheme *sc, s7_pointer table, s7_pointer key, s7_pointer value);  
                                                                             /* (hash-table-set! table key value) */
-  /* a hash-table is a vector of alists '((symbol value)), so to iterate over a hash-table
-   *   use for-each which calls its function with each of these alists.  An entry defaults to nil.
+  /* a hash-table is a vector of (key . value) pairs, so to iterate over a hash-table
+   *   use for-each which calls its function with each of these pairs.  A missing key's value is #f,
+   *   and setting a key's value to #f removes it.  The table grows as needed.
    */
   /* hash-tables are applicable:
       (let ((hash (make-hash-table)))
@@ -852,6 +873,10 @@ void s7_mark_object(s7_pointer p);
  * 
  *        s7 changes
  *
+ * 19-Oct:    s7_gc_history, gc-history.
+ *            hash-tables grow as needed, and setting a key's value to #f removes it.
+ *            s7_make_integer shares one immutable cell per integer from -1024 to 65535 (see INTEGER_CACHE_MIN in s7.c).
+ *            input files of 64 KBytes or more are mapped (if HAVE_MMAP) and read in place, whatever their size.
  * 14-Mar:    s7_make_random_state, optional state argument to s7_random, random-state->list.
  * 10-Feb:    s7_vector_print_length, s7_set_vector_print_length.
  * 7-Feb:     s7_begin_hook, s7_set_begin_hook.
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "s7.h"
+
+//
+//  Loads each Scheme file named on the command line into a fresh
+//  interpreter and prints how long it took, best of three. Used by
+//  "make bench" to compare builds of s7.c.
+//
+static const int RUNS = 3;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf( stderr, "usage: %s file.scm...\n", argv[0] );
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        double best = 0.0;
+        for (int run = 0; run < RUNS; ++run)
+        {
+            s7_scheme *sc = s7_init();
+
+            double start = now();
+            s7_load( sc, argv[i] );
+            double elapsed = now() - start;
+
+            if (run == 0 || elapsed < best)
+                best = elapsed;
+        }
+        printf( "%-24s %8.3f s\n", argv[i], best );
+    }
+
+    return 0;
+}
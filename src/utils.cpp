@@ -84,3 +84,11 @@ void set_cursor_at_line( Glib::RefPtr<Gtk::TextBuffer> buffer, int line, bool ex
     set_cursor( iter, ext_sel );
 }
 
+int get_last_line( Glib::RefPtr<Gtk::TextBuffer> buffer )
+{
+    int n = buffer->get_line_count();
+    Gtk::TextIter end = buffer->end();
+    if (n > 1 && end.starts_line())
+        n--;
+    return n;
+}
@@ -42,6 +42,12 @@ void set_cursor( Gtk::TextBuffer::iterator location, bool ext_sel );
 
 void set_cursor_at_line( Glib::RefPtr<Gtk::TextBuffer> buffer, int line, bool ext_sel );
 
+/**
+ *  Returns the number of the last line (from 1). An empty line after
+ *  a final newline is not counted, as in Vim.
+ */
+int get_last_line( Glib::RefPtr<Gtk::TextBuffer> buffer );
+
 /**
  *  converts a ustring to type T
  *